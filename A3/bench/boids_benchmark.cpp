@@ -0,0 +1,69 @@
+// Headless benchmark of the FlockingSystem: 10k boids, timings per phase
+// usage: boids_benchmark [num_threads] [num_boids] [num_steps]
+
+// stlib
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+// internal
+#include "flocking_system.hpp"
+#include "thread_pool.hpp"
+#include "tiny_ecs_registry.hpp"
+
+const float WORLD_WIDTH = 1200.f * 4;
+const float WORLD_HEIGHT = 800.f * 4;
+const float STEP_MS = 1000.f / 60.f;
+
+int main(int argc, char* argv[])
+{
+	unsigned int num_threads = argc > 1 ? (unsigned int)atoi(argv[1]) : 0;
+	int num_boids = argc > 2 ? atoi(argv[2]) : 10000;
+	int num_steps = argc > 3 ? atoi(argv[3]) : 200;
+	thread_pool.init(num_threads);
+
+	// Scatter the boids with random headings, always swimming upstream
+	std::default_random_engine rng(427);
+	std::uniform_real_distribution<float> uniform_dist; // number between 0..1
+	for (int i = 0; i < num_boids; i++) {
+		Entity entity;
+		Motion& motion = registry.motions.emplace(entity);
+		motion.position = { uniform_dist(rng) * WORLD_WIDTH, uniform_dist(rng) * WORLD_HEIGHT };
+		motion.velocity = { -100.f - uniform_dist(rng) * 100.f, -200.f + uniform_dist(rng) * 400.f };
+		registry.softShells.emplace(entity);
+		registry.flocks.emplace(entity);
+	}
+
+	FlockingSystem flocking;
+	FlockingSystem::PhaseTimings total;
+	double neighbours = 0;
+	for (int s = 0; s < num_steps; s++) {
+		flocking.step(STEP_MS);
+		// Move the boids like the PhysicsSystem would, wrapping around the world
+		for (Motion& motion : registry.motions.components) {
+			motion.position += motion.velocity * (STEP_MS / 1000.f);
+			motion.position.x = fmodf(motion.position.x + WORLD_WIDTH, WORLD_WIDTH);
+			motion.position.y = fmodf(motion.position.y + WORLD_HEIGHT, WORLD_HEIGHT);
+		}
+		const FlockingSystem::PhaseTimings& t = flocking.last_timings();
+		total.gather_ms += t.gather_ms;
+		total.grid_ms += t.grid_ms;
+		total.steer_ms += t.steer_ms;
+		total.integrate_ms += t.integrate_ms;
+	}
+	for (Flocking& flock : registry.flocks.components)
+		neighbours += flock.neighbour_count;
+
+	float n = (float)num_steps;
+	printf("boids: %d, threads: %u, steps: %d, avg neighbours: %.1f\n",
+		num_boids, thread_pool.size(), num_steps, neighbours / num_boids);
+	printf("%-10s %8s\n", "phase", "ms/step");
+	printf("%-10s %8.3f\n", "gather", total.gather_ms / n);
+	printf("%-10s %8.3f\n", "grid", total.grid_ms / n);
+	printf("%-10s %8.3f\n", "steer", total.steer_ms / n);
+	printf("%-10s %8.3f\n", "integrate", total.integrate_ms / n);
+	printf("%-10s %8.3f\n", "total", (total.gather_ms + total.grid_ms + total.steer_ms + total.integrate_ms) / n);
+
+	registry.clear_all_components();
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,322 @@
+// Google Benchmark suite of the ComponentContainer operations (insert, emplace, get, has, remove, clear, sort,
+// sort_incremental and a position update loop) at several sizes, for the two layouts of A0's ecs_demo: an array of structs
+// (one PVData container) and a struct of arrays (a float container each for the position and the velocity), the
+// latter once more with the two containers in an OwningGroup.
+// The results are written to ecs_benchmark.json unless --benchmark_out is given, compare two runs with
+// benchmark's tools/compare.py to spot regressions.
+// usage: ecs_benchmark [--benchmark_filter=regex] [--benchmark_out=file.json] ...
+
+#include <benchmark/benchmark.h>
+
+// stlib
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+// internal
+#include "tiny_ecs.hpp"
+
+// As in A0/src/ecs_demo.cpp
+struct PVData {
+	float pos;
+	float vel;
+	PVData(float pos, float vel) : pos{ pos }, vel{ vel } {};
+};
+
+// Array of structs, position and velocity side by side
+struct AoS
+{
+	ComponentContainer<PVData> position_velocity;
+
+	void insert(Entity e, float value) { position_velocity.insert(e, PVData(value, 1.f)); }
+	void emplace(Entity e, float value) { position_velocity.emplace(e, value, 1.f); }
+	float get(Entity e) { const PVData& data = position_velocity.get(e); return data.pos + data.vel; }
+	bool has(Entity e) { return position_velocity.has(e); }
+	void remove(Entity e) { position_velocity.remove(e); }
+	void clear() { position_velocity.clear(); }
+	template <class Compare>
+	void sort(Compare compare) { position_velocity.sort(compare); }
+	template <class Compare>
+	void sort_incremental(Compare compare) { position_velocity.sort_incremental(compare); }
+	void integrate(float dt)
+	{
+		for (PVData& data : position_velocity.components)
+			data.pos += data.vel * dt;
+	}
+};
+
+// Struct of arrays, one container per field. The two containers see the same inserts, removes and sorts,
+// so the components at an index belong to the same entity
+struct SoA
+{
+	ComponentContainer<float> position;
+	ComponentContainer<float> velocity;
+
+	void insert(Entity e, float value) { position.insert(e, value); velocity.insert(e, 1.f); }
+	void emplace(Entity e, float value) { position.emplace(e, value); velocity.emplace(e, 1.f); }
+	float get(Entity e) { return position.get(e) + velocity.get(e); }
+	bool has(Entity e) { return position.has(e); }
+	void remove(Entity e) { position.remove(e); velocity.remove(e); }
+	void clear() { position.clear(); velocity.clear(); }
+	template <class Compare>
+	void sort(Compare compare) { position.sort(compare); velocity.sort(compare); }
+	template <class Compare>
+	void sort_incremental(Compare compare) { position.sort_incremental(compare); velocity.sort_incremental(compare); }
+	void integrate(float dt)
+	{
+		float* positions = position.components.data();
+		const float* velocities = velocity.components.data();
+		for (size_t i = 0; i < position.components.size(); i++)
+			positions[i] += velocities[i] * dt;
+	}
+};
+
+// Struct of arrays kept aligned by an OwningGroup instead of by doing the same to both containers: the sorts
+// only sort the position, the group puts the velocity in the same order
+struct Grouped
+{
+	ComponentContainer<float> position;
+	ComponentContainer<float> velocity;
+	OwningGroup group{ &position, &velocity };
+
+	void insert(Entity e, float value) { position.insert(e, value); velocity.insert(e, 1.f); }
+	void emplace(Entity e, float value) { position.emplace(e, value); velocity.emplace(e, 1.f); }
+	float get(Entity e) { return position.get(e) + velocity.get(e); }
+	bool has(Entity e) { return position.has(e); }
+	void remove(Entity e) { position.remove(e); velocity.remove(e); }
+	void clear() { position.clear(); velocity.clear(); }
+	template <class Compare>
+	void sort(Compare compare) { position.sort(compare); }
+	template <class Compare>
+	void sort_incremental(Compare compare) { position.sort_incremental(compare); }
+	void integrate(float dt)
+	{
+		float* positions = position.components.data();
+		const float* velocities = velocity.components.data();
+		unsigned int count = group.size();
+		for (unsigned int i = 0; i < count; i++)
+			positions[i] += velocities[i] * dt;
+	}
+};
+
+// The entities of a benchmark in a random order, so that the hash map lookups don't follow the insertion order
+static std::vector<Entity> make_entities(size_t count)
+{
+	std::vector<Entity> entities(count);
+	std::shuffle(entities.begin(), entities.end(), std::default_random_engine(427));
+	return entities;
+}
+
+template <class Layout>
+static void fill(Layout& layout, const std::vector<Entity>& entities)
+{
+	for (size_t i = 0; i < entities.size(); i++)
+		layout.insert(entities[i], (float)i);
+}
+
+// Into a cleared container, which keeps its capacity and recycled map nodes like one in the game
+template <class Layout>
+static void BM_Insert(benchmark::State& state)
+{
+	std::vector<Entity> entities = make_entities((size_t)state.range(0));
+	Layout layout;
+	for (auto _ : state) {
+		state.PauseTiming();
+		layout.clear();
+		state.ResumeTiming();
+		fill(layout, entities);
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template <class Layout>
+static void BM_Emplace(benchmark::State& state)
+{
+	std::vector<Entity> entities = make_entities((size_t)state.range(0));
+	Layout layout;
+	for (auto _ : state) {
+		state.PauseTiming();
+		layout.clear();
+		state.ResumeTiming();
+		for (size_t i = 0; i < entities.size(); i++)
+			layout.emplace(entities[i], (float)i);
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template <class Layout>
+static void BM_Get(benchmark::State& state)
+{
+	std::vector<Entity> entities = make_entities((size_t)state.range(0));
+	Layout layout;
+	fill(layout, entities);
+	std::shuffle(entities.begin(), entities.end(), std::default_random_engine(1));
+	for (auto _ : state) {
+		float sum = 0.f;
+		for (Entity e : entities)
+			sum += layout.get(e);
+		benchmark::DoNotOptimize(sum);
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// Half of the lookups miss
+template <class Layout>
+static void BM_Has(benchmark::State& state)
+{
+	std::vector<Entity> entities = make_entities((size_t)state.range(0) * 2);
+	Layout layout;
+	for (size_t i = 0; i < entities.size(); i += 2)
+		layout.insert(entities[i], (float)i);
+	for (auto _ : state) {
+		size_t found = 0;
+		for (Entity e : entities)
+			found += layout.has(e);
+		benchmark::DoNotOptimize(found);
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0) * 2);
+}
+
+// Every component, in a different order than they were inserted
+template <class Layout>
+static void BM_Remove(benchmark::State& state)
+{
+	std::vector<Entity> entities = make_entities((size_t)state.range(0));
+	std::vector<Entity> removes = entities;
+	std::shuffle(removes.begin(), removes.end(), std::default_random_engine(1));
+	Layout layout;
+	for (auto _ : state) {
+		state.PauseTiming();
+		fill(layout, entities);
+		state.ResumeTiming();
+		for (Entity e : removes)
+			layout.remove(e);
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template <class Layout>
+static void BM_Clear(benchmark::State& state)
+{
+	std::vector<Entity> entities = make_entities((size_t)state.range(0));
+	Layout layout;
+	for (auto _ : state) {
+		state.PauseTiming();
+		fill(layout, entities);
+		state.ResumeTiming();
+		layout.clear();
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// The order of the sort benchmarks. A lambda like the game's comparators, a function pointer isn't inlined into the sort
+static const auto by_id = [](Entity a, Entity b) { return entity_less(a, b); };
+
+// By entity id, from the random insertion order
+template <class Layout>
+static void BM_Sort(benchmark::State& state)
+{
+	std::vector<Entity> entities = make_entities((size_t)state.range(0));
+	Layout layout;
+	for (auto _ : state) {
+		state.PauseTiming();
+		layout.clear();
+		fill(layout, entities);
+		state.ResumeTiming();
+		layout.sort(by_id);
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// Sorted by entity id, except for 1% of neighbours that swapped places, like depths or positions a frame later
+static std::vector<Entity> make_nearly_sorted_entities(size_t count)
+{
+	std::vector<Entity> entities(count);
+	std::default_random_engine rng(427);
+	for (size_t i = 0; i < count / 100; i++) {
+		size_t at = rng() % (count - 1);
+		std::swap(entities[at], entities[at + 1]);
+	}
+	return entities;
+}
+
+template <class Layout>
+static void BM_SortNearlySorted(benchmark::State& state)
+{
+	std::vector<Entity> entities = make_nearly_sorted_entities((size_t)state.range(0));
+	Layout layout;
+	for (auto _ : state) {
+		state.PauseTiming();
+		layout.clear();
+		fill(layout, entities);
+		state.ResumeTiming();
+		layout.sort(by_id);
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+template <class Layout>
+static void BM_SortIncrementalNearlySorted(benchmark::State& state)
+{
+	std::vector<Entity> entities = make_nearly_sorted_entities((size_t)state.range(0));
+	Layout layout;
+	for (auto _ : state) {
+		state.PauseTiming();
+		layout.clear();
+		fill(layout, entities);
+		state.ResumeTiming();
+		layout.sort_incremental(by_id);
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// What the layout is for: a system streaming over the components, position += velocity * dt
+template <class Layout>
+static void BM_Integrate(benchmark::State& state)
+{
+	std::vector<Entity> entities = make_entities((size_t)state.range(0));
+	Layout layout;
+	fill(layout, entities);
+	for (auto _ : state) {
+		layout.integrate(1.f / 60.f);
+		benchmark::ClobberMemory();
+	}
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// 256 to 256k components, from a few game entities to well past the caches
+#define ECS_BENCHMARK(name) \
+	BENCHMARK_TEMPLATE(name, AoS)->RangeMultiplier(8)->Range(1 << 8, 1 << 18); \
+	BENCHMARK_TEMPLATE(name, SoA)->RangeMultiplier(8)->Range(1 << 8, 1 << 18); \
+	BENCHMARK_TEMPLATE(name, Grouped)->RangeMultiplier(8)->Range(1 << 8, 1 << 18)
+
+ECS_BENCHMARK(BM_Insert);
+ECS_BENCHMARK(BM_Emplace);
+ECS_BENCHMARK(BM_Get);
+ECS_BENCHMARK(BM_Has);
+ECS_BENCHMARK(BM_Remove);
+ECS_BENCHMARK(BM_Clear);
+ECS_BENCHMARK(BM_Sort);
+ECS_BENCHMARK(BM_SortNearlySorted);
+ECS_BENCHMARK(BM_SortIncrementalNearlySorted);
+ECS_BENCHMARK(BM_Integrate);
+
+int main(int argc, char* argv[])
+{
+	// JSON results by default, next to the console table
+	std::vector<char*> args(argv, argv + argc);
+	bool has_out = std::any_of(args.begin(), args.end(), [](const char* arg) { return std::string(arg).rfind("--benchmark_out=", 0) == 0; });
+	std::string out = "--benchmark_out=ecs_benchmark.json", format = "--benchmark_out_format=json";
+	if (!has_out) {
+		args.push_back(&out[0]);
+		args.push_back(&format[0]);
+	}
+	int count = (int)args.size();
+	benchmark::Initialize(&count, args.data());
+	if (benchmark::ReportUnrecognizedArguments(count, args.data()))
+		return 1;
+	benchmark::RunSpecifiedBenchmarks();
+	benchmark::Shutdown();
+	return 0;
+}
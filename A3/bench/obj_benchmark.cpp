@@ -0,0 +1,200 @@
+// Benchmark of Mesh::loadFromOBJFile against the fscanf loader it replaced, on a generated grid mesh of a
+// few megabytes (or the given OBJ file, which must use the "v//vn" faces the old loader reads).
+// A second, larger grid has more vertices than 16 bit indices can address and only loads with the new one.
+// usage: obj_benchmark [obj file] [repetitions]
+
+// components.cpp includes the renderer's headers
+#define GL3W_IMPLEMENTATION
+#include <gl3w.h>
+
+// stlib
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// internal
+#include "components.hpp"
+
+// The loader before the parser in obj_parser.cpp, without the bounds and normalization which both share
+static bool fscanf_load(std::string obj_path, std::vector<ColoredVertex>& out_vertices, std::vector<uint16_t>& out_vertex_indices)
+{
+	std::vector<uint16_t> out_normal_indices;
+	std::vector<glm::vec2> out_uvs;
+	std::vector<glm::vec3> out_normals;
+
+	FILE* file = fopen(obj_path.c_str(), "r");
+	if (file == NULL)
+		return false;
+
+	while (1) {
+		char lineHeader[128];
+		int res = fscanf(file, "%s", lineHeader);
+		if (res == EOF)
+			break;
+
+		if (strcmp(lineHeader, "v") == 0) {
+			ColoredVertex vertex;
+			fscanf(file, "%f %f %f %f %f %f\n", &vertex.position.x, &vertex.position.y, &vertex.position.z,
+				                                &vertex.color.x, &vertex.color.y, &vertex.color.z);
+			out_vertices.push_back(vertex);
+		}
+		else if (strcmp(lineHeader, "vt") == 0) {
+			glm::vec2 uv;
+			fscanf(file, "%f %f\n", &uv.x, &uv.y);
+			uv.y = -uv.y;
+			out_uvs.push_back(uv);
+		}
+		else if (strcmp(lineHeader, "vn") == 0) {
+			glm::vec3 normal;
+			fscanf(file, "%f %f %f\n", &normal.x, &normal.y, &normal.z);
+			out_normals.push_back(normal);
+		}
+		else if (strcmp(lineHeader, "f") == 0) {
+			unsigned int vertexIndex[3], normalIndex[3];
+			int matches = fscanf(file, "%d//%d %d//%d %d//%d\n", &vertexIndex[0], &normalIndex[0], &vertexIndex[1], &normalIndex[1], &vertexIndex[2], &normalIndex[2]);
+			if (matches != 6) {
+				fclose(file);
+				return false;
+			}
+			out_vertex_indices.push_back((uint16_t)vertexIndex[0] - 1);
+			out_vertex_indices.push_back((uint16_t)vertexIndex[1] - 1);
+			out_vertex_indices.push_back((uint16_t)vertexIndex[2] - 1);
+			out_normal_indices.push_back((uint16_t)normalIndex[0] - 1);
+			out_normal_indices.push_back((uint16_t)normalIndex[1] - 1);
+			out_normal_indices.push_back((uint16_t)normalIndex[2] - 1);
+		}
+		else {
+			char stupidBuffer[1000];
+			fgets(stupidBuffer, 1000, file);
+		}
+	}
+	fclose(file);
+	return true;
+}
+
+// A colored grid of size x size vertices with two "v//vn" triangles per cell
+static bool write_grid(const std::string& path, int size)
+{
+	FILE* file = fopen(path.c_str(), "w");
+	if (file == NULL)
+		return false;
+	fprintf(file, "# %d x %d grid written by obj_benchmark\n", size, size);
+	for (int y = 0; y < size; y++)
+		for (int x = 0; x < size; x++) {
+			float u = (float)x / (size - 1), v = (float)y / (size - 1);
+			fprintf(file, "v %f %f %f %f %f %f\n", u * 2.f - 1.f, v * 2.f - 1.f, 0.05f * u * v, u, v, 1.f - u);
+		}
+	fprintf(file, "vn 0.000000 0.000000 1.000000\n");
+	for (int y = 0; y + 1 < size; y++)
+		for (int x = 0; x + 1 < size; x++) {
+			int corner = y * size + x + 1;
+			fprintf(file, "f %d//1 %d//1 %d//1\n", corner, corner + 1, corner + size);
+			fprintf(file, "f %d//1 %d//1 %d//1\n", corner + 1, corner + size + 1, corner + size);
+		}
+	return fclose(file) == 0;
+}
+
+static long file_size(const std::string& path)
+{
+	FILE* file = fopen(path.c_str(), "rb");
+	if (file == NULL)
+		return 0;
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fclose(file);
+	return size;
+}
+
+typedef std::chrono::high_resolution_clock Clock;
+
+static double ms_since(Clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+int main(int argc, char* argv[])
+{
+	std::string path = argc > 1 ? argv[1] : "obj_benchmark_grid.obj";
+	int repetitions = argc > 2 ? atoi(argv[2]) : 5;
+	bool generated = argc <= 1;
+	// 62500 vertices, still addressable with the old loader's 16 bit indices
+	if (generated && !write_grid(path, 250)) {
+		fprintf(stderr, "Could not write %s\n", path.c_str());
+		return 1;
+	}
+	double megabytes = file_size(path) / (1024.0 * 1024.0);
+
+	std::vector<ColoredVertex> old_vertices, new_vertices;
+	std::vector<uint16_t> old_indices;
+	std::vector<uint32_t> new_indices;
+	vec2 size;
+	double old_ms = 1e30, new_ms = 1e30;
+	for (int i = 0; i < repetitions; i++) {
+		old_vertices.clear();
+		old_indices.clear();
+		Clock::time_point start = Clock::now();
+		if (!fscanf_load(path, old_vertices, old_indices)) {
+			fprintf(stderr, "The fscanf loader can't read %s\n", path.c_str());
+			return 1;
+		}
+		old_ms = std::min(old_ms, ms_since(start));
+
+		start = Clock::now();
+		if (!Mesh::loadFromOBJFile(path, new_vertices, new_indices, size)) {
+			fprintf(stderr, "The OBJ parser can't read %s\n", path.c_str());
+			return 1;
+		}
+		new_ms = std::min(new_ms, ms_since(start));
+	}
+
+	// The new loader normalizes, compare what the old one read after the same normalization
+	vec3 max_position = { -99999,-99999,-99999 };
+	vec3 min_position = { 99999,99999,99999 };
+	for (ColoredVertex& vertex : old_vertices) {
+		max_position = glm::max(max_position, vertex.position);
+		min_position = glm::min(min_position, vertex.position);
+	}
+	min_position.z = 0;
+	max_position.z = 1;
+	float max_difference = 0.f;
+	bool same = old_vertices.size() == new_vertices.size() && old_indices.size() == new_indices.size();
+	for (size_t i = 0; same && i < old_vertices.size(); i++) {
+		vec3 position = ((old_vertices[i].position - min_position) / (max_position - min_position)) - vec3(0.5f, 0.5f, 0.f);
+		vec3 difference = glm::abs(position - new_vertices[i].position);
+		vec3 color_difference = glm::abs(old_vertices[i].color - new_vertices[i].color);
+		vec3 largest = glm::max(difference, color_difference);
+		max_difference = std::max(max_difference, std::max(largest.x, std::max(largest.y, largest.z)));
+	}
+	for (size_t i = 0; same && i < old_indices.size(); i++)
+		same = old_indices[i] == new_indices[i];
+	same = same && max_difference < 1e-5f;
+
+	printf("\n%s: %.1f MB, %zu vertices, %zu triangles, best of %d\n", path.c_str(), megabytes, new_vertices.size(), new_indices.size() / 3, repetitions);
+	printf("  fscanf loader   %8.1f ms %8.1f MB/s\n", old_ms, megabytes / (old_ms / 1000.0));
+	printf("  OBJ parser      %8.1f ms %8.1f MB/s  %.1fx\n", new_ms, megabytes / (new_ms / 1000.0), old_ms / new_ms);
+	printf("  same mesh: %s (largest difference %g)\n", same ? "yes" : "NO", max_difference);
+
+	if (generated) {
+		// 160000 vertices, past the 65536 of 16 bit indices
+		std::string large_path = "obj_benchmark_large_grid.obj";
+		if (!write_grid(large_path, 400)) {
+			fprintf(stderr, "Could not write %s\n", large_path.c_str());
+			return 1;
+		}
+		Clock::time_point start = Clock::now();
+		bool loaded = Mesh::loadFromOBJFile(large_path, new_vertices, new_indices, size);
+		double large_ms = ms_since(start);
+		uint32_t max_index = 0;
+		for (uint32_t index : new_indices)
+			max_index = std::max(max_index, index);
+		printf("\n%s: %.1f MB, %zu vertices, largest index %u, %s in %.1f ms\n", large_path.c_str(), file_size(large_path) / (1024.0 * 1024.0),
+			new_vertices.size(), max_index, loaded ? "loaded" : "FAILED", large_ms);
+		remove(large_path.c_str());
+		remove(path.c_str());
+	}
+	return same ? 0 : 1;
+}
@@ -0,0 +1,124 @@
+// Headless benchmark of the PhysicsSystem and the AISystem on the job system, the same scene is
+// simulated once per thread count and the time per step is compared to the first run
+// usage: physics_benchmark [num_pebbles] [num_fish] [num_steps] [thread counts...]
+
+// The physics uses Transform from common.cpp, which also has the GL error check
+#define GL3W_IMPLEMENTATION
+#include <gl3w.h>
+
+// stlib
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+// internal
+#include "ai_system.hpp"
+#include "frame_arena.hpp"
+#include "physics_system.hpp"
+#include "thread_pool.hpp"
+#include "tiny_ecs_registry.hpp"
+#include "world_init.hpp"
+
+const float WINDOW_WIDTH = 1200.f;
+const float WINDOW_HEIGHT = 800.f;
+const float STEP_MS = 1000.f / 60.f;
+
+// Only the mesh based collisions of the player and the debug drawing use the projection, the scene
+// keeps the player away from the walls and debug mode off, so there is no renderer
+mat3 RenderSystem::createProjectionMatrix()
+{
+	return mat3(1.f);
+}
+
+static void create_scene(int num_pebbles, int num_fish)
+{
+	std::default_random_engine rng(427);
+	std::uniform_real_distribution<float> uniform_dist; // number between 0..1
+
+	// The player floats in the middle of the screen
+	Entity player;
+	Motion& player_motion = registry.motions.emplace(player);
+	player_motion.position = { WINDOW_WIDTH / 2, WINDOW_HEIGHT / 2 };
+	player_motion.scale = { -150.f, 150.f }; // about the salmon mesh
+	registry.players.emplace(player);
+	// The wall collisions of the player test its mesh, a unit square is enough here
+	static Mesh player_mesh;
+	player_mesh.vertices.clear();
+	for (vec2 corner : { vec2(-0.5f, -0.5f), vec2(0.5f, -0.5f), vec2(0.5f, 0.5f), vec2(-0.5f, 0.5f) }) {
+		ColoredVertex vertex;
+		vertex.position = { corner.x, corner.y, 0.f };
+		vertex.color = { 1.f, 1.f, 1.f };
+		player_mesh.vertices.push_back(vertex);
+	}
+	registry.meshPtrs.emplace(player, &player_mesh);
+
+	for (int i = 0; i < num_pebbles; i++) {
+		float size = 10.f + uniform_dist(rng) * 20.f;
+		Entity pebble = createPebble({ uniform_dist(rng) * WINDOW_WIDTH, uniform_dist(rng) * WINDOW_HEIGHT }, { size, size });
+		Physics& physics = registry.physics.get(pebble);
+		physics.radius = size / 2;
+		registry.motions.get(pebble).velocity = { -100.f + uniform_dist(rng) * 200.f, 0.f };
+	}
+	// Like createFish, without the mesh and the render request
+	for (int i = 0; i < num_fish; i++) {
+		Entity fish;
+		Motion& motion = registry.motions.emplace(fish);
+		motion.position = { uniform_dist(rng) * WINDOW_WIDTH, uniform_dist(rng) * WINDOW_HEIGHT };
+		motion.velocity = { -50.f, 0.f };
+		motion.scale = { -FISH_BB_WIDTH, FISH_BB_HEIGHT };
+		registry.softShells.emplace(fish);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	int num_pebbles = argc > 1 ? atoi(argv[1]) : 1000;
+	int num_fish = argc > 2 ? atoi(argv[2]) : 500;
+	int num_steps = argc > 3 ? atoi(argv[3]) : 100;
+	std::vector<unsigned int> thread_counts;
+	for (int i = 4; i < argc; i++)
+		thread_counts.push_back((unsigned int)atoi(argv[i]));
+	if (thread_counts.empty())
+		thread_counts = { 1, 2, 4, 8, 16 };
+
+	debugging.is_advance_physics = true;
+	debugging.is_advance_ai = true;
+
+	printf("pebbles: %d, fish: %d, steps: %d, cores: %u\n",
+		num_pebbles, num_fish, num_steps, std::thread::hardware_concurrency());
+	printf("%-8s %12s %12s %12s %8s %10s\n", "threads", "physics ms", "ai ms", "total ms", "speedup", "collisions");
+	double single_thread_ms = 0;
+	for (unsigned int num_threads : thread_counts) {
+		thread_pool.init(num_threads);
+		create_scene(num_pebbles, num_fish);
+		PhysicsSystem physics;
+		AISystem ai;
+
+		double physics_ms = 0, ai_ms = 0;
+		size_t collisions = 0;
+		for (int s = 0; s < num_steps; s++) {
+			auto t0 = std::chrono::high_resolution_clock::now();
+			physics.step(STEP_MS, WINDOW_WIDTH, WINDOW_HEIGHT, nullptr);
+			auto t1 = std::chrono::high_resolution_clock::now();
+			ai.step(STEP_MS, WINDOW_WIDTH, WINDOW_HEIGHT);
+			auto t2 = std::chrono::high_resolution_clock::now();
+			physics_ms += std::chrono::duration<double, std::milli>(t1 - t0).count();
+			ai_ms += std::chrono::duration<double, std::milli>(t2 - t1).count();
+			// The collisions are handled by the WorldSystem in the game
+			collisions += registry.collisions.size();
+			registry.collisions.clear();
+			frame_arena.reset();
+		}
+
+		double n = (double)num_steps;
+		double total_ms = (physics_ms + ai_ms) / n;
+		if (single_thread_ms == 0)
+			single_thread_ms = total_ms;
+		printf("%-8u %12.3f %12.3f %12.3f %7.2fx %10zu\n",
+			thread_pool.size(), physics_ms / n, ai_ms / n, total_ms, single_thread_ms / total_ms, collisions);
+		registry.clear_all_components();
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,148 @@
+// Headless scaling benchmark: runs a stress scenario (see src/scenario.hpp) through the flocking, physics
+// and AI systems at several multiples of its population and prints how the time per tick grows. Each scale
+// runs once in spawn order and once sorted along a Z-order curve (see src/spatial_sort.hpp), with the
+// hardware cache misses per tick where perf events are available.
+// usage: scenario_benchmark ["fish=200 turtles=50 pebbles=200 placement=uniform speed=50:200 ticks=300 seed=427"] [scales...]
+
+// The physics uses Transform from common.cpp, which also has the GL error check
+#define GL3W_IMPLEMENTATION
+#include <gl3w.h>
+
+// stlib
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+// internal
+#include "ai_system.hpp"
+#include "cache_miss_counter.hpp"
+#include "entity_pool.hpp"
+#include "flocking_system.hpp"
+#include "frame_arena.hpp"
+#include "physics_system.hpp"
+#include "profiler.hpp"
+#include "scenario.hpp"
+#include "spatial_sort.hpp"
+#include "thread_pool.hpp"
+#include "tiny_ecs_registry.hpp"
+#include "world_init.hpp"
+
+const float WINDOW_WIDTH = 1200.f;
+const float WINDOW_HEIGHT = 800.f;
+const float STEP_MS = 1000.f / 60.f;
+const unsigned int SPATIAL_SORT_EVERY_X_TICKS = 30; // as in the game
+
+// Only the mesh based collisions of the player and the debug drawing use the projection, the scene
+// keeps debug mode off
+mat3 RenderSystem::createProjectionMatrix()
+{
+	return mat3(1.f);
+}
+
+int main(int argc, char* argv[])
+{
+	Scenario base;
+	if (!parseScenario(argc > 1 ? argv[1] : "fish=200 turtles=50 pebbles=200 ticks=300", base))
+		return EXIT_FAILURE;
+	std::vector<unsigned int> scales;
+	for (int i = 2; i < argc; i++)
+		scales.push_back((unsigned int)atoi(argv[i]));
+	if (scales.empty())
+		scales = { 1, 2, 5, 10, 20 };
+
+	// On the calling thread, so that the cache miss counter sees the work of all systems
+	thread_pool.init(1);
+	debugging.is_advance_physics = true;
+	debugging.is_advance_ai = true;
+	CacheMissCounter cache_misses;
+	if (!cache_misses.open())
+		printf("No hardware cache miss counter (needs Linux perf events), only the times are compared\n");
+
+	// The meshes only hold the vertices here, nothing is uploaded. The renderer is never freed, its
+	// destructor releases GL objects
+	RenderSystem* renderer = new RenderSystem();
+	Mesh& salmon_mesh = renderer->getMesh(GEOMETRY_BUFFER_ID::SALMON);
+	if (!Mesh::loadCached(mesh_path("salmon.obj"), salmon_mesh.vertices, salmon_mesh.vertex_indices, salmon_mesh.original_size)) {
+		fprintf(stderr, "Could not load %s\n", mesh_path("salmon.obj").c_str());
+		return EXIT_FAILURE;
+	}
+
+	struct Result
+	{
+		unsigned int scale;
+		size_t entities;
+		double tick_ms[2];          // in spawn order, spatially sorted
+		double physics_ms[2];       // p50
+		double cache_misses[2];     // per tick
+	};
+	std::vector<Result> results;
+	const std::vector<const char*> scopes = { "flocking", "physics", "physics.narrowphase", "physics.pebble_contacts", "physics.gravity", "ai", "spatial_sort" };
+	for (unsigned int scale : scales) {
+		Scenario scenario = base;
+		scenario.fish *= scale;
+		scenario.turtles *= scale;
+		scenario.pebbles *= scale;
+		Result result = { scale, 0, {}, {}, {} };
+		// The same scene twice, the second time sorted along a Z-order curve every SPATIAL_SORT_EVERY_X_TICKS
+		for (int spatial = 0; spatial < 2; spatial++) {
+			createSalmon(renderer, { 100, 200 });
+			populateScenario(scenario, renderer, { WINDOW_WIDTH, WINDOW_HEIGHT });
+			result.entities = registry.motions.size();
+			FlockingSystem flocking;
+			PhysicsSystem physics;
+			AISystem ai;
+
+			profiler.clear_stats();
+			uint64_t misses_before = cache_misses.read();
+			auto start = std::chrono::high_resolution_clock::now();
+			for (unsigned int tick = 0; tick < scenario.ticks; tick++) {
+				if (spatial && tick % SPATIAL_SORT_EVERY_X_TICKS == 0)
+					sortSpatially({ WINDOW_WIDTH, WINDOW_HEIGHT });
+				uint64_t tick_misses = cache_misses.read();
+				{
+					PROFILE_SCOPE("flocking");
+					flocking.step(STEP_MS);
+				}
+				{
+					PROFILE_SCOPE("physics");
+					physics.step(STEP_MS, WINDOW_WIDTH, WINDOW_HEIGHT, renderer);
+				}
+				{
+					PROFILE_SCOPE("ai");
+					ai.step(STEP_MS, WINDOW_WIDTH, WINDOW_HEIGHT);
+				}
+				if (cache_misses.is_open())
+					profiler.add_counter("cache_misses", (double)(cache_misses.read() - tick_misses));
+				// The collisions are handled by the WorldSystem in the game
+				registry.collisions.clear();
+				frame_arena.reset();
+				profiler.end_frame();
+			}
+			double wall_ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+			printf("%s\n", spatial ? "Spatially sorted:" : "In spawn order:");
+			printScenarioReport(scenario, scenario.ticks, wall_ms, scopes);
+			result.tick_ms[spatial] = wall_ms / scenario.ticks;
+			result.physics_ms[spatial] = profiler.stats("physics").p50_ms;
+			result.cache_misses[spatial] = (double)(cache_misses.read() - misses_before) / scenario.ticks;
+			// Like WorldSystem::restart_game, the pooled entities are re-used by the next run
+			registry.apply_deferred();
+			while (registry.motions.entities.size() > 0)
+				destroyEntity(registry.motions.entities.back());
+		}
+		results.push_back(result);
+	}
+
+	// Linear scaling keeps the time per entity flat
+	printf("\n%-8s %10s %12s %16s %14s %14s %14s %14s\n", "scale", "entities", "ms/tick", "us/entity/tick",
+		"physics p50", "sorted p50", "misses/tick", "sorted misses");
+	for (const Result& result : results) {
+		printf("%-8u %10zu %12.3f %16.3f %14.3f %14.3f", result.scale, result.entities, result.tick_ms[0],
+			result.tick_ms[0] * 1000.0 / result.entities, result.physics_ms[0], result.physics_ms[1]);
+		if (cache_misses.is_open())
+			printf(" %14.0f %14.0f\n", result.cache_misses[0], result.cache_misses[1]);
+		else
+			printf(" %14s %14s\n", "-", "-");
+	}
+	return EXIT_SUCCESS;
+}
@@ -1,11 +1,15 @@
 // internal
 #include "ai_system.hpp"
+#include "frame_arena.hpp"
+#include "profiler.hpp"
+#include "thread_pool.hpp"
 #include "world_init.hpp"
 
-int timer = 0;
-vec2 fish_vel = {};
+const size_t AGENTS_PER_JOB = 64;
+const int PREDICTION_STEPS = 100;
+const int PREDICTION_STEPS_PER_DEBUG_DOT = 10;
 
-bool is_bounding_boxes_overlap(Motion& m1, Motion& m2, vec2 box1, vec2 box2) {
+bool is_bounding_boxes_overlap(const Motion& m1, const Motion& m2, vec2 box1, vec2 box2) {
 	vec2 center1 = m1.position;
 	vec2 center2 = m2.position;
 	float x_min1 = center1.x - box1.x / 2;
@@ -22,21 +26,102 @@ bool is_bounding_boxes_overlap(Motion& m1, Motion& m2, vec2 box1, vec2 box2) {
 	return false;
 }
 
-Motion predict_player_motion(Motion& player_motion, float window_width_px, float window_height_px, vec2& bounding_box) {
+// Simulates the player a second ahead, path receives the position after every step
+Motion predict_player_motion(const Motion& player_motion, float window_width_px, float window_height_px, vec2& bounding_box, FrameVector<vec2>& path) {
 	Motion predicted_motion = Motion();
 	predicted_motion.position = player_motion.position;
 	predicted_motion.velocity = player_motion.velocity;
 	predicted_motion.acceleration = player_motion.acceleration;
 	predicted_motion.scale = player_motion.scale;
 	float t = (10 / 1000.f);
-	for (int i = 0; i < 100; i++) {
+	path.reserve(PREDICTION_STEPS);
+	for (int i = 0; i < PREDICTION_STEPS; i++) {
 		step_update_position(predicted_motion, t);
 		step_update_swimming_acceleration(predicted_motion, t);
 		step_handle_player_wall_bb_collision(predicted_motion, t, bounding_box);
+		path.push_back(predicted_motion.position);
 	}
 	return predicted_motion;
 }
 
+// Runs the dodging state machine of fish [begin, end). Every fish only reads the shared inputs
+// and writes its own SoftShell, Motion and result slot, so chunks can run on any thread.
+void AISystem::step_agents(size_t begin, size_t end, const SharedInputs& in)
+{
+	PROFILE_SCOPE("ai.agents");
+	const Motion& player_motion = in.player_motion;
+	const Motion& projected_motion = in.projected_motion;
+	const float epsilon = in.epsilon;
+	for (size_t i = begin; i < end; i++)
+	{
+		Motion& motion_i = *agent_motions[i];
+		SoftShell& soft_shell = *agent_shells[i];
+		AgentResult& result = agent_results[i];
+		result = AgentResult();
+		vec2 soft_shell_bounding_box = get_bounding_box(motion_i);
+		bool player_overlap = is_bounding_boxes_overlap(player_motion, motion_i, in.player_range_box, soft_shell_bounding_box);
+		bool projected_overlap = is_bounding_boxes_overlap(projected_motion, motion_i, in.player_range_box, soft_shell_bounding_box);
+		switch (soft_shell.state) {
+		case SoftShell::NORMAL:
+			if (player_overlap || (in.is_advance_ai && projected_overlap)) {
+				result.player_motion_overlap = player_overlap;
+				result.projected_motion_overlap = projected_overlap;
+				soft_shell.velocity_prev = motion_i.velocity;
+				if (soft_shell.update_frame_counter <= 0) {
+					soft_shell.state = SoftShell::UPDATING;
+				}
+				else {
+					soft_shell.state = SoftShell::DODGING;
+				}
+			}
+			break;
+		case SoftShell::UPDATING: {
+			result.player_motion_overlap = player_overlap;
+			result.projected_motion_overlap = projected_overlap;
+			if (motion_i.position.x <= player_motion.position.x && in.is_advance_ai) {
+				motion_i.velocity.x = -200;
+			}
+			else {
+				motion_i.velocity.x = 0;
+			}
+			if (player_motion.position.y - epsilon / 2 < soft_shell_bounding_box.y ||
+				projected_motion.position.y - epsilon / 2 < soft_shell_bounding_box.y) {
+				motion_i.velocity.y = 200;
+			}
+			else if (player_motion.position.y + epsilon / 2 > in.window_height_px - soft_shell_bounding_box.y ||
+					projected_motion.position.y + epsilon / 2 > in.window_height_px - soft_shell_bounding_box.y) {
+				motion_i.velocity.y = -200;
+			}
+			else if (motion_i.position.y <= projected_motion.position.y) {
+				motion_i.velocity.y = -200;
+			}
+			else if (motion_i.position.y > projected_motion.position.y) {
+				motion_i.velocity.y = 200;
+			}
+			soft_shell.dodge_velocity = motion_i.velocity;
+			result.started_update = true;
+			soft_shell.update_frame_counter = in.ai_update_every_X_frames;
+			soft_shell.state = SoftShell::DODGING;
+			break;
+		}
+		case SoftShell::DODGING:
+			result.player_motion_overlap = player_overlap;
+			result.projected_motion_overlap = projected_overlap;
+			if (soft_shell.update_frame_counter <= 0) {
+				soft_shell.state = SoftShell::UPDATING;
+			}
+			if (!player_overlap) {
+				motion_i.velocity = { soft_shell.velocity_prev.x, 0 };
+				soft_shell.state = SoftShell::NORMAL;
+			}
+			break;
+		}
+		if (!in.in_freeze_mode && soft_shell.update_frame_counter > 0) {
+			soft_shell.update_frame_counter--;
+		}
+	}
+}
+
 void AISystem::step(float elapsed_ms, float window_width_px, float window_height_px)
 {
 	// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
@@ -46,87 +131,55 @@ void AISystem::step(float elapsed_ms, float window_width_px, float window_height
 	// new data structures to implement a more sophisticated Fish AI.
 	// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
 	Entity& player_entity = registry.players.entities[0];
-	Motion& player_motion = registry.motions.get(player_entity);
+	// A copy, the debug lines below add motions and may move the container
+	const Motion player_motion = registry.motions.get(player_entity);
 	int epsilon = 400;
-	vec2 player_range_box = { epsilon, epsilon };
 	vec2 bounding_box = vec2();
-	Motion projected_motion = predict_player_motion(player_motion, window_width_px, window_height_px, bounding_box);
-	bool is_player_motion_overlap = false, is_projected_motion_overlap = false;
-	ComponentContainer<Motion>& motion_container = registry.motions;
-	for (uint i = 0; i < motion_container.components.size(); i++)
+	FrameVector<vec2> predicted_path; // only needed this frame, lives in the frame arena
+
+	// Everything the fish look at is computed once up front and copied, so no fish can see another's writes
+	SharedInputs inputs;
+	inputs.player_motion = player_motion;
 	{
-		Motion& motion_i = motion_container.components[i];
-		Entity entity_i = motion_container.entities[i];
-		if (registry.softShells.has(entity_i)) {
-			SoftShell& soft_shell = registry.softShells.get(entity_i);
-			vec2 soft_shell_bounding_box = get_bounding_box(motion_i);
-			switch (soft_shell.state) {
-			case SoftShell::NORMAL:
-				if (is_bounding_boxes_overlap(player_motion, motion_i, player_range_box, soft_shell_bounding_box) ||
-					(debugging.is_advance_ai &&	is_bounding_boxes_overlap(projected_motion, motion_i, player_range_box, soft_shell_bounding_box))) {
-					is_player_motion_overlap = is_player_motion_overlap || is_bounding_boxes_overlap(player_motion, motion_i, player_range_box, soft_shell_bounding_box);
-					is_projected_motion_overlap = is_projected_motion_overlap || is_bounding_boxes_overlap(projected_motion, motion_i, player_range_box, soft_shell_bounding_box);
-					soft_shell.velocity_prev = motion_i.velocity;
-					if (soft_shell.update_frame_counter <= 0) {
-						soft_shell.state = SoftShell::UPDATING;
-					}
-					else {
-						soft_shell.state = SoftShell::DODGING;
-					}
-				}
-				break;
-			case SoftShell::UPDATING: {
-				is_player_motion_overlap = is_player_motion_overlap || is_bounding_boxes_overlap(player_motion, motion_i, player_range_box, soft_shell_bounding_box);
-				is_projected_motion_overlap = is_projected_motion_overlap || is_bounding_boxes_overlap(projected_motion, motion_i, player_range_box, soft_shell_bounding_box);
-				if (motion_i.position.x <= player_motion.position.x && debugging.is_advance_ai) {
-					motion_i.velocity.x = -200;
-				}
-				else {
-					motion_i.velocity.x = 0;
-				}
-				if (player_motion.position.y - epsilon / 2 < soft_shell_bounding_box.y ||
-					projected_motion.position.y - epsilon / 2 < soft_shell_bounding_box.y) {
-					motion_i.velocity.y = 200;
-				}
-				else if (player_motion.position.y + epsilon / 2 > window_height_px - soft_shell_bounding_box.y ||
-						projected_motion.position.y + epsilon / 2 > window_height_px - soft_shell_bounding_box.y) {
-					motion_i.velocity.y = -200;
-				}
-				else if (motion_i.position.y <= projected_motion.position.y) {
-					motion_i.velocity.y = -200;
-				}
-				else if (motion_i.position.y > projected_motion.position.y) {
-					motion_i.velocity.y = 200;
-				}
-				fish_vel = { motion_i.velocity.x, motion_i.velocity.y };
-				if (!debugging.in_freeze_mode) {
-					timer = 500;
-				}
-				soft_shell.update_frame_counter = debugging.ai_update_every_X_frames;
-				soft_shell.state = SoftShell::DODGING;
-				break;
-			}
-			case SoftShell::DODGING:
-				is_player_motion_overlap = is_player_motion_overlap || is_bounding_boxes_overlap(player_motion, motion_i, player_range_box, soft_shell_bounding_box);
-				is_projected_motion_overlap = is_projected_motion_overlap || is_bounding_boxes_overlap(projected_motion, motion_i, player_range_box, soft_shell_bounding_box);
-				if (soft_shell.update_frame_counter <= 0) {
-					soft_shell.state = SoftShell::UPDATING;
-				}
-				if (!is_bounding_boxes_overlap(player_motion, motion_i, player_range_box, soft_shell_bounding_box)) {
-					motion_i.velocity = { soft_shell.velocity_prev.x, 0 };
-					soft_shell.state = SoftShell::NORMAL;
-				}
-				break;
-			}
-			if (!debugging.in_freeze_mode && soft_shell.update_frame_counter > 0) {
-				soft_shell.update_frame_counter--;
-			}
-		}
+		PROFILE_SCOPE("ai.prediction");
+		inputs.projected_motion = predict_player_motion(player_motion, window_width_px, window_height_px, bounding_box, predicted_path);
 	}
+	inputs.player_range_box = { epsilon, epsilon };
+	inputs.epsilon = (float)epsilon;
+	inputs.window_height_px = window_height_px;
+	inputs.is_advance_ai = debugging.is_advance_ai;
+	inputs.in_freeze_mode = debugging.in_freeze_mode;
+	inputs.ai_update_every_X_frames = debugging.ai_update_every_X_frames;
+	const Motion& projected_motion = inputs.projected_motion;
 
-	if (timer > 0 && debugging.in_debug_mode) {
+	// Partition the fish into chunks, each fish writes only its own state and result slot
+	ComponentContainer<SoftShell>& softshell_container = registry.softShells;
+	size_t num_agents = softshell_container.size();
+	agent_motions.resize(num_agents);
+	agent_shells.resize(num_agents);
+	agent_results.resize(num_agents);
+	for (size_t i = 0; i < num_agents; i++) {
+		agent_motions[i] = &registry.motions.get(softshell_container.entities[i]);
+		agent_shells[i] = &softshell_container.components[i];
+	}
+	thread_pool.parallel_for(num_agents, AGENTS_PER_JOB, [this, &inputs](size_t begin, size_t end) {
+		step_agents(begin, end, inputs);
+	});
+
+	// Reduce the per-fish results, all reductions are order independent so the thread count doesn't matter
+	bool is_player_motion_overlap = false, is_projected_motion_overlap = false, any_started_update = false;
+	for (const AgentResult& result : agent_results) {
+		is_player_motion_overlap = is_player_motion_overlap || result.player_motion_overlap;
+		is_projected_motion_overlap = is_projected_motion_overlap || result.projected_motion_overlap;
+		any_started_update = any_started_update || result.started_update;
+	}
+	if (any_started_update && !debugging.in_freeze_mode) {
+		freeze_timer_ms = 500;
+	}
+
+	if (freeze_timer_ms > 0 && debugging.in_debug_mode) {
 		debugging.in_freeze_mode = true;
-		timer -= elapsed_ms;
+		freeze_timer_ms -= elapsed_ms;
 	}
 	else {
 		debugging.in_freeze_mode = false;
@@ -139,39 +192,38 @@ void AISystem::step(float elapsed_ms, float window_width_px, float window_height
 	// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
 	if (debugging.in_debug_mode && debugging.in_freeze_mode) {
 		if (is_player_motion_overlap) {
-			Entity lineLeft = createLine(player_motion.position - vec2({ epsilon / 2.f, 0 }), { player_motion.scale.x / 30, epsilon });
-			Entity lineRight = createLine(player_motion.position + vec2({ epsilon / 2.f, 0 }), { player_motion.scale.x / 30, epsilon });
-			Entity lineTop = createLine(player_motion.position - vec2({ 0, epsilon / 2.f }), { epsilon, player_motion.scale.x / 30 });
-			Entity lineBot = createLine(player_motion.position + vec2({ 0, epsilon / 2.f }), { epsilon, player_motion.scale.x / 30 });
+			drawDebugLine(player_motion.position - vec2({ epsilon / 2.f, 0 }), { player_motion.scale.x / 30, epsilon });
+			drawDebugLine(player_motion.position + vec2({ epsilon / 2.f, 0 }), { player_motion.scale.x / 30, epsilon });
+			drawDebugLine(player_motion.position - vec2({ 0, epsilon / 2.f }), { epsilon, player_motion.scale.x / 30 });
+			drawDebugLine(player_motion.position + vec2({ 0, epsilon / 2.f }), { epsilon, player_motion.scale.x / 30 });
 		}
 		if (is_projected_motion_overlap && debugging.is_advance_ai) {
-			Entity lineLeft = createLine(projected_motion.position - vec2({ epsilon / 2.f, 0 }), { player_motion.scale.x / 30, epsilon });
-			Entity lineRight = createLine(projected_motion.position + vec2({ epsilon / 2.f, 0 }), { player_motion.scale.x / 30, epsilon });
-			Entity lineTop = createLine(projected_motion.position - vec2({ 0, epsilon / 2.f }), { epsilon, player_motion.scale.x / 30 });
-			Entity lineBot = createLine(projected_motion.position + vec2({ 0, epsilon / 2.f }), { epsilon, player_motion.scale.x / 30 });
+			drawDebugLine(projected_motion.position - vec2({ epsilon / 2.f, 0 }), { player_motion.scale.x / 30, epsilon });
+			drawDebugLine(projected_motion.position + vec2({ epsilon / 2.f, 0 }), { player_motion.scale.x / 30, epsilon });
+			drawDebugLine(projected_motion.position - vec2({ 0, epsilon / 2.f }), { epsilon, player_motion.scale.x / 30 });
+			drawDebugLine(projected_motion.position + vec2({ 0, epsilon / 2.f }), { epsilon, player_motion.scale.x / 30 });
 		}
-		for (uint i = 0; i < motion_container.components.size(); i++)
+		for (uint i = 0; i < softshell_container.size(); i++)
 		{
-			Motion& motion_i = motion_container.components[i];
-			Entity entity_i = motion_container.entities[i];
-			if (registry.softShells.has(entity_i)) {
-				SoftShell& soft_shell = registry.softShells.get(entity_i);
-				vec2 soft_shell_bounding_box = get_bounding_box(motion_i);
-				switch (soft_shell.state) {
-				case SoftShell::DODGING: {
-					if (fish_vel.y && fish_vel.x) {
-						float angle = atan2f(fish_vel.y, fish_vel.x) + M_PI / 2;
-						float len = sqrt(fish_vel.y * fish_vel.y + fish_vel.x * fish_vel.x);
-						Entity lineBot = createLine(motion_i.position + vec2({ fish_vel.x / 2, fish_vel.y / 2 }),
-							{ fish_vel.x / 50, len }, angle);
-					}
-					else {
-						Entity lineBot = createLine(motion_i.position - vec2({ 0, -motion_i.velocity.y / 2 }),
-							{ motion_i.scale.x / 30, -motion_i.velocity.y });
-					}
-					break;
+			SoftShell& soft_shell = softshell_container.components[i];
+			Motion& motion_i = registry.motions.get(softshell_container.entities[i]);
+			switch (soft_shell.state) {
+			case SoftShell::DODGING: {
+				vec2 fish_vel = soft_shell.dodge_velocity;
+				if (fish_vel.y && fish_vel.x) {
+					float angle = atan2f(fish_vel.y, fish_vel.x) + M_PI / 2;
+					float len = sqrt(fish_vel.y * fish_vel.y + fish_vel.x * fish_vel.x);
+					drawDebugLine(motion_i.position + vec2({ fish_vel.x / 2, fish_vel.y / 2 }),
+						{ fish_vel.x / 50, len }, angle);
 				}
+				else {
+					drawDebugLine(motion_i.position - vec2({ 0, -motion_i.velocity.y / 2 }),
+						{ motion_i.scale.x / 30, -motion_i.velocity.y });
 				}
+				break;
+			}
+			default:
+				break;
 			}
 		}
 	}
@@ -179,16 +231,18 @@ void AISystem::step(float elapsed_ms, float window_width_px, float window_height
 		Motion& player_motion = registry.motions.get(player_entity);
 		float vel_angle = atan2f(player_motion.velocity.y, player_motion.velocity.x) + M_PI / 2;
 		float vel_len = sqrt(player_motion.velocity.y * player_motion.velocity.y + player_motion.velocity.x * player_motion.velocity.x);
-		Entity player_vel = createLine(player_motion.position + vec2({ player_motion.velocity.x / 2, player_motion.velocity.y / 2 }),
+		drawDebugLine(player_motion.position + vec2({ player_motion.velocity.x / 2, player_motion.velocity.y / 2 }),
 			{ player_motion.scale.x / 30, vel_len }, vel_angle);
 		float acc_angle = atan2f(player_motion.acceleration.y, player_motion.acceleration.x) + M_PI / 2;
 		float acc_len = sqrt(player_motion.acceleration.y * player_motion.acceleration.y + player_motion.acceleration.x * player_motion.acceleration.x);
-		Entity player_acc = createLine(player_motion.position + vec2({ player_motion.acceleration.x / 2, player_motion.acceleration.y / 2 }),
+		drawDebugLine(player_motion.position + vec2({ player_motion.acceleration.x / 2, player_motion.acceleration.y / 2 }),
 			{ player_motion.scale.x / 30, acc_len }, acc_angle);
+		for (size_t i = PREDICTION_STEPS_PER_DEBUG_DOT - 1; i < predicted_path.size(); i += PREDICTION_STEPS_PER_DEBUG_DOT)
+			drawDebugLine(predicted_path[i], { player_motion.scale.x / 25, player_motion.scale.x / 25 });
 		const vec2 bonding_box = get_bounding_box(projected_motion);
-		Entity lineLeft = createLine(projected_motion.position - vec2({ bounding_box.x / 2.f, 0 }), { player_motion.scale.x / 30, bounding_box.y });
-		Entity lineRight = createLine(projected_motion.position + vec2({ bounding_box.x / 2.f, 0 }), { player_motion.scale.x / 30, bounding_box.y });
-		Entity lineTop = createLine(projected_motion.position - vec2({ 0, bounding_box.y / 2 }), { bounding_box.x, player_motion.scale.x / 30 });
-		Entity lineBot = createLine(projected_motion.position + vec2({ 0, bounding_box.y / 2 }), { bounding_box.x, player_motion.scale.x / 30 });
+		drawDebugLine(projected_motion.position - vec2({ bounding_box.x / 2.f, 0 }), { player_motion.scale.x / 30, bounding_box.y });
+		drawDebugLine(projected_motion.position + vec2({ bounding_box.x / 2.f, 0 }), { player_motion.scale.x / 30, bounding_box.y });
+		drawDebugLine(projected_motion.position - vec2({ 0, bounding_box.y / 2 }), { bounding_box.x, player_motion.scale.x / 30 });
+		drawDebugLine(projected_motion.position + vec2({ 0, bounding_box.y / 2 }), { bounding_box.x, player_motion.scale.x / 30 });
 	}
 }
\ No newline at end of file
@@ -16,4 +16,34 @@ class AISystem
 {
 public:
 	void step(float elapsed_ms, float window_width_px, float window_height_px);
+
+private:
+	// Read-only inputs shared by every fish during the parallel pass
+	struct SharedInputs {
+		Motion player_motion;
+		Motion projected_motion;
+		vec2 player_range_box;
+		float epsilon;
+		float window_height_px;
+		bool is_advance_ai;
+		bool in_freeze_mode;
+		int ai_update_every_X_frames;
+	};
+
+	// What each fish reports back, reduced in agent order once the pass is done
+	struct AgentResult {
+		bool player_motion_overlap = false;
+		bool projected_motion_overlap = false;
+		bool started_update = false;
+	};
+
+	void step_agents(size_t begin, size_t end, const SharedInputs& inputs);
+
+	// Fish handled this step, gathered before the pass so workers never touch the hash maps
+	std::vector<Motion*> agent_motions;
+	std::vector<SoftShell*> agent_shells;
+	std::vector<AgentResult> agent_results;
+
+	// Time left in the debug freeze after a fish updated its path
+	float freeze_timer_ms = 0;
 };
\ No newline at end of file
@@ -0,0 +1,81 @@
+// internal
+#include "alloc_tracker.hpp"
+
+// stlib
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// Constant initialized, so that allocations made by static constructors are counted too
+static std::atomic<uint64_t> total_allocation_count{ 0 };
+static std::atomic<uint64_t> total_allocated_bytes{ 0 };
+static std::atomic<uint64_t> total_free_count{ 0 };
+static thread_local AllocationCounts thread_counts;
+
+AllocationCounts total_allocations()
+{
+	AllocationCounts counts;
+	counts.allocations = total_allocation_count.load(std::memory_order_relaxed);
+	counts.bytes = total_allocated_bytes.load(std::memory_order_relaxed);
+	counts.frees = total_free_count.load(std::memory_order_relaxed);
+	return counts;
+}
+
+AllocationCounts thread_allocations()
+{
+	return thread_counts;
+}
+
+static void* tracked_malloc(size_t size)
+{
+	if (size == 0)
+		size = 1;
+	total_allocation_count.fetch_add(1, std::memory_order_relaxed);
+	total_allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+	thread_counts.allocations++;
+	thread_counts.bytes += size;
+	return malloc(size);
+}
+
+static void tracked_free(void* p)
+{
+	if (p == nullptr)
+		return;
+	total_free_count.fetch_add(1, std::memory_order_relaxed);
+	thread_counts.frees++;
+	free(p);
+}
+
+// Replacements of the global allocation functions, every new and delete in the program goes through these
+void* operator new(size_t size)
+{
+	void* p = tracked_malloc(size);
+	if (p == nullptr)
+		throw std::bad_alloc();
+	return p;
+}
+
+void* operator new[](size_t size)
+{
+	void* p = tracked_malloc(size);
+	if (p == nullptr)
+		throw std::bad_alloc();
+	return p;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	return tracked_malloc(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return tracked_malloc(size);
+}
+
+void operator delete(void* p) noexcept { tracked_free(p); }
+void operator delete[](void* p) noexcept { tracked_free(p); }
+void operator delete(void* p, size_t) noexcept { tracked_free(p); }
+void operator delete[](void* p, size_t) noexcept { tracked_free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { tracked_free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { tracked_free(p); }
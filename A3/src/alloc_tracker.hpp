@@ -0,0 +1,20 @@
+#pragma once
+
+// stlib
+#include <stdint.h>
+
+// Counts heap allocations through the global operator new/delete (see alloc_tracker.cpp).
+// The totals cover all threads, the thread counts let the profiler charge allocations to the
+// scope that made them.
+struct AllocationCounts
+{
+	uint64_t allocations = 0;
+	uint64_t bytes = 0;
+	uint64_t frees = 0;
+};
+
+// Everything allocated so far by all threads
+AllocationCounts total_allocations();
+
+// Everything allocated so far by the calling thread
+AllocationCounts thread_allocations();
@@ -0,0 +1,64 @@
+// internal
+#include "cache_miss_counter.hpp"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+CacheMissCounter::~CacheMissCounter()
+{
+	close();
+}
+
+#ifdef __linux__
+
+bool CacheMissCounter::open()
+{
+	close();
+	perf_event_attr attributes;
+	memset(&attributes, 0, sizeof(attributes));
+	attributes.size = sizeof(attributes);
+	attributes.type = PERF_TYPE_HARDWARE;
+	attributes.config = PERF_COUNT_HW_CACHE_MISSES;
+	attributes.exclude_kernel = 1;
+	attributes.exclude_hv = 1;
+	// This thread, on any CPU
+	fd = (int)syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0);
+	return fd >= 0;
+}
+
+void CacheMissCounter::close()
+{
+	if (fd >= 0)
+		::close(fd);
+	fd = -1;
+}
+
+uint64_t CacheMissCounter::read() const
+{
+	uint64_t count = 0;
+	if (fd < 0 || ::read(fd, &count, sizeof(count)) != sizeof(count))
+		return 0;
+	return count;
+}
+
+#else
+
+bool CacheMissCounter::open()
+{
+	return false;
+}
+
+void CacheMissCounter::close()
+{
+}
+
+uint64_t CacheMissCounter::read() const
+{
+	return 0;
+}
+
+#endif
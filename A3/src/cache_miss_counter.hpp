@@ -0,0 +1,27 @@
+#pragma once
+
+// stlib
+#include <stdint.h>
+
+// Counts the cache misses (references that missed the last level cache) of the calling thread with
+// the hardware performance counters. Linux only, through perf_event_open; elsewhere, in most virtual
+// machines and with kernel.perf_event_paranoid > 2 open() fails and the counter stays at 0.
+class CacheMissCounter
+{
+public:
+	CacheMissCounter() {}
+	~CacheMissCounter();
+	CacheMissCounter(const CacheMissCounter&) = delete;
+	CacheMissCounter& operator=(const CacheMissCounter&) = delete;
+
+	// Starts counting from 0, false if the counter isn't available
+	bool open();
+	void close();
+	bool is_open() const { return fd >= 0; }
+
+	// Misses since open(), 0 if it isn't open
+	uint64_t read() const;
+
+private:
+	int fd = -1;
+};
@@ -1,4 +1,6 @@
 #include "components.hpp"
+#include "mapped_file.hpp"
+#include "obj_parser.hpp"
 #include "render_system.hpp" // for gl_has_errors
 
 #define STB_IMAGE_IMPLEMENTATION
@@ -12,80 +14,21 @@ Debug debugging;
 float death_timer_counter_ms = 3000;
 
 
-// Very, VERY simple OBJ loader from https://github.com/opengl-tutorials/ogl tutorial 7
-// (modified to also read vertex color and omit uv and normals)
-bool Mesh::loadFromOBJFile(std::string obj_path, std::vector<ColoredVertex>& out_vertices, std::vector<uint16_t>& out_vertex_indices, vec2& out_size)
+// Loads the vertex positions, colors and triangles of an OBJ file (see obj_parser.hpp) and normalizes them
+bool Mesh::loadFromOBJFile(std::string obj_path, std::vector<ColoredVertex>& out_vertices, std::vector<uint32_t>& out_vertex_indices, vec2& out_size)
 {
-	// disable warnings about fscanf and fopen on Windows
-#ifdef _MSC_VER
-	#pragma warning(disable:4996)
-#endif
-
 	printf("Loading OBJ file %s...\n", obj_path.c_str());
-	// Note, normal and UV indices are currently not used
-	std::vector<uint16_t> out_uv_indices, out_normal_indices;
-	std::vector<glm::vec2> out_uvs;
-	std::vector<glm::vec3> out_normals;
-
-	FILE* file = fopen(obj_path.c_str(), "r");
-	if (file == NULL) {
-		printf("Impossible to open the file ! Are you in the right path ? See Tutorial 1 for details\n");
-		getchar();
+	MappedFile file;
+	if (!file.open(obj_path)) {
+		// Meshes load on worker threads, report and let the caller decide instead of waiting for a key
+		fprintf(stderr, "Impossible to open the file %s ! Are you in the right path ? See Tutorial 1 for details\n", obj_path.c_str());
 		return false;
 	}
-
-	while (1) {
-		char lineHeader[128];
-		// read the first word of the line
-		int res = fscanf(file, "%s", lineHeader);
-		if (res == EOF)
-			break; // EOF = End Of File. Quit the loop.
-
-		if (strcmp(lineHeader, "v") == 0) {
-			ColoredVertex vertex;
-			fscanf(file, "%f %f %f %f %f %f\n", &vertex.position.x, &vertex.position.y, &vertex.position.z,
-				                                &vertex.color.x, &vertex.color.y, &vertex.color.z);
-			out_vertices.push_back(vertex);
-		}
-		else if (strcmp(lineHeader, "vt") == 0) {
-			glm::vec2 uv;
-			fscanf(file, "%f %f\n", &uv.x, &uv.y);
-			uv.y = -uv.y; // Invert V coordinate since we will only use DDS texture, which are inverted. Remove if you want to use TGA or BMP loaders.
-			out_uvs.push_back(uv);
-		}
-		else if (strcmp(lineHeader, "vn") == 0) {
-			glm::vec3 normal;
-			fscanf(file, "%f %f %f\n", &normal.x, &normal.y, &normal.z);
-			out_normals.push_back(normal);
-		}
-		else if (strcmp(lineHeader, "f") == 0) {
-			std::string vertex1, vertex2, vertex3;
-			unsigned int vertexIndex[3], normalIndex[3]; // , uvIndex[3]
-			//int matches = fscanf(file, "%d/%d/%d %d/%d/%d %d/%d/%d\n", &vertexIndex[0], &uvIndex[0], &normalIndex[0], &vertexIndex[1], &uvIndex[1], &normalIndex[1], &vertexIndex[2], &uvIndex[2], &normalIndex[2]);
-			int matches = fscanf(file, "%d//%d %d//%d %d//%d\n", &vertexIndex[0], &normalIndex[0], &vertexIndex[1], &normalIndex[1], &vertexIndex[2], &normalIndex[2]);
-			if (matches != 6) {
-				printf("File can't be read by our simple parser :-( Try exporting with other options\n");
-				fclose(file);
-				return false;
-			}
-			// -1 since .obj starts counting at 1 and OpenGL starts at 0
-			out_vertex_indices.push_back((uint16_t)vertexIndex[0] - 1);
-			out_vertex_indices.push_back((uint16_t)vertexIndex[1] - 1);
-			out_vertex_indices.push_back((uint16_t)vertexIndex[2] - 1);
-			//out_uv_indices.push_back(uvIndex[0] - 1);
-			//out_uv_indices.push_back(uvIndex[1] - 1);
-			//out_uv_indices.push_back(uvIndex[2] - 1);
-			out_normal_indices.push_back((uint16_t)normalIndex[0] - 1);
-			out_normal_indices.push_back((uint16_t)normalIndex[1] - 1);
-			out_normal_indices.push_back((uint16_t)normalIndex[2] - 1);
-		}
-		else {
-			// Probably a comment, eat up the rest of the line
-			char stupidBuffer[1000];
-			fgets(stupidBuffer, 1000, file);
-		}
+	std::string error;
+	if (!parseOBJ((const char*)file.data(), file.size(), out_vertices, out_vertex_indices, error)) {
+		fprintf(stderr, "File %s can't be read by our parser, %s\n", obj_path.c_str(), error.c_str());
+		return false;
 	}
-	fclose(file);
 
 	// Compute bounds of the mesh
 	vec3 max_position = { -99999,-99999,-99999 };
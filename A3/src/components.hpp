@@ -25,10 +25,19 @@ struct SoftShell
 		DODGING
 	};
 	vec2 velocity_prev = { 0, 0 };
+	vec2 dodge_velocity = { 0, 0 }; // velocity picked by the last path update
 	AiState state = NORMAL;
 	int update_frame_counter = 0;
 };
 
+// Fish that school with nearby fish (boids), steered by the FlockingSystem
+struct Flocking
+{
+	float neighbour_radius = 150;
+	float separation_radius = 60;
+	int neighbour_count = 0; // neighbours considered in the last update, for debugging
+};
+
 // All data relevant to the shape and motion of entities
 struct Motion {
 	vec2 position = { 0, 0 };
@@ -104,10 +113,13 @@ struct TexturedVertex
 // Mesh datastructure for storing vertex and index buffers
 struct Mesh
 {
-	static bool loadFromOBJFile(std::string obj_path, std::vector<ColoredVertex>& out_vertices, std::vector<uint16_t>& out_vertex_indices, vec2& out_size);
+	static bool loadFromOBJFile(std::string obj_path, std::vector<ColoredVertex>& out_vertices, std::vector<uint32_t>& out_vertex_indices, vec2& out_size);
+	// Loads the binary cache next to the OBJ file (obj_path + ".bin"), it is written on the first load
+	// and whenever the OBJ file changed, see mesh_cache.cpp
+	static bool loadCached(std::string obj_path, std::vector<ColoredVertex>& out_vertices, std::vector<uint32_t>& out_vertex_indices, vec2& out_size);
 	vec2 original_size = {1,1};
 	std::vector<ColoredVertex> vertices;
-	std::vector<uint16_t> vertex_indices;
+	std::vector<uint32_t> vertex_indices;
 };
 
 // DONE A1: Add a timer that will light the salmon up upon eating a fish
@@ -167,6 +179,21 @@ enum class GEOMETRY_BUFFER_ID {
 };
 const int geometry_count = (int)GEOMETRY_BUFFER_ID::GEOMETRY_COUNT;
 
+// Entities that are spawned and despawned all the time are recycled through an EntityPool per prefab
+enum class PREFAB_ID {
+	FISH = 0,
+	TURTLE = FISH + 1,
+	PEBBLE = TURTLE + 1,
+	PREFAB_COUNT = PEBBLE + 1
+};
+const int prefab_count = (int)PREFAB_ID::PREFAB_COUNT;
+
+// Marks an entity that belongs to the pool of its prefab
+struct Pooled
+{
+	PREFAB_ID prefab = PREFAB_ID::PREFAB_COUNT;
+};
+
 struct RenderRequest {
 	TEXTURE_ASSET_ID used_texture = TEXTURE_ASSET_ID::TEXTURE_COUNT;
 	EFFECT_ASSET_ID used_effect = EFFECT_ASSET_ID::EFFECT_COUNT;
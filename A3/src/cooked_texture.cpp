@@ -0,0 +1,33 @@
+// internal
+#include "cooked_texture.hpp"
+
+// stlib
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+bool readCookedTexture(const MappedFile& file, const std::string& png_path, CookedTextureHeader& out_header, std::vector<CookedTextureLevel>& out_levels)
+{
+	if (file.size() < sizeof(CookedTextureHeader))
+		return false;
+	memcpy(&out_header, file.data(), sizeof(CookedTextureHeader));
+	if (memcmp(out_header.magic, "CTEX", 4) != 0 || out_header.version != COOKED_TEXTURE_VERSION ||
+		(out_header.format != CookedTextureFormat::RGBA8 && out_header.format != CookedTextureFormat::BC3) ||
+		out_header.mip_count == 0 || out_header.mip_count > 32)
+		return false;
+
+	struct stat source;
+	if (stat(png_path.c_str(), &source) == 0 &&
+		(out_header.source_mtime != (int64_t)source.st_mtime || out_header.source_size != (uint64_t)source.st_size))
+		return false;
+
+	size_t levels_end = sizeof(CookedTextureHeader) + out_header.mip_count * sizeof(CookedTextureLevel);
+	if (file.size() < levels_end)
+		return false;
+	out_levels.resize(out_header.mip_count);
+	memcpy(out_levels.data(), file.data() + sizeof(CookedTextureHeader), out_header.mip_count * sizeof(CookedTextureLevel));
+	for (const CookedTextureLevel& level : out_levels)
+		if (level.offset < levels_end || level.offset > file.size() || level.size > file.size() - level.offset)
+			return false;
+	return true;
+}
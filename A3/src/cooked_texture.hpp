@@ -0,0 +1,47 @@
+#pragma once
+
+// stlib
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// internal
+#include "mapped_file.hpp"
+
+// A texture cooked from a PNG by tools/texture_cooker.cpp: the whole mip chain in the format it is uploaded
+// in, so that loading it is a memory mapping and one glTexImage2D or glCompressedTexImage2D per level.
+// Layout: CookedTextureHeader, mip_count CookedTextureLevel, then the payload of each level at its offset.
+enum class CookedTextureFormat : uint32_t
+{
+	RGBA8 = 0,
+	BC3 = 1, // DXT5, 4x4 blocks of 16 bytes with an interpolated alpha, needs EXT_texture_compression_s3tc
+};
+
+struct CookedTextureHeader
+{
+	char magic[4];        // "CTEX"
+	uint32_t version;
+	CookedTextureFormat format;
+	uint32_t width;
+	uint32_t height;
+	uint32_t mip_count;
+	int64_t source_mtime; // of the PNG the texture was cooked from, a changed PNG makes it stale
+	uint64_t source_size;
+};
+
+struct CookedTextureLevel
+{
+	uint32_t width;
+	uint32_t height;
+	uint64_t offset;      // from the start of the file
+	uint64_t size;
+};
+
+const uint32_t COOKED_TEXTURE_VERSION = 1;
+
+// Where the cooked texture of a PNG is, next to it
+inline std::string cookedTexturePath(const std::string& png_path) { return png_path + ".tex"; }
+
+// Checks a mapped cooked texture and reads its levels. False if it isn't one, is truncated or, when the
+// PNG exists, was cooked from a different version of it
+bool readCookedTexture(const MappedFile& file, const std::string& png_path, CookedTextureHeader& out_header, std::vector<CookedTextureLevel>& out_levels);
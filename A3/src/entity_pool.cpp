@@ -0,0 +1,63 @@
+// internal
+#include "entity_pool.hpp"
+#include "tiny_ecs_registry.hpp"
+
+// Make sure these remain in sync with the PREFAB_ID enumerators.
+std::array<EntityPool, prefab_count> entity_pools = {
+	EntityPool(PREFAB_ID::FISH),
+	EntityPool(PREFAB_ID::TURTLE),
+	EntityPool(PREFAB_ID::PEBBLE) };
+
+static const char* prefab_names[prefab_count] = { "fish", "turtle", "pebble" };
+
+Entity EntityPool::acquire()
+{
+	// Entity() takes a new id, so only construct one when there is none to reuse
+	Entity entity = free_entities.empty() ? Entity() : free_entities.back();
+	if (free_entities.size() > 0) {
+		free_entities.pop_back();
+		pool_stats.reused++;
+	}
+	else
+		pool_stats.created++;
+	pool_stats.live++;
+	pool_stats.peak_live = std::max(pool_stats.peak_live, pool_stats.live);
+	pool_stats.free = free_entities.size();
+
+	Pooled pooled;
+	pooled.prefab = prefab;
+	registry.pooled.insert(entity, pooled);
+	return entity;
+}
+
+void EntityPool::release(Entity entity)
+{
+	recycle(entity);
+	registry.remove_all_components_of(entity);
+}
+
+void EntityPool::recycle(Entity entity)
+{
+	assert(registry.pooled.has(entity) && registry.pooled.get(entity).prefab == prefab);
+	free_entities.push_back(entity);
+	pool_stats.live--;
+	pool_stats.free = free_entities.size();
+}
+
+void destroyEntity(Entity entity)
+{
+	if (registry.pooled.has(entity))
+		entity_pools[(int)registry.pooled.get(entity).prefab].release(entity);
+	else
+		registry.remove_all_components_of(entity);
+}
+
+void printEntityPoolStats()
+{
+	printf("Entity pools:\n");
+	for (int i = 0; i < prefab_count; i++) {
+		const EntityPool::Stats& stats = entity_pools[i].stats();
+		printf("%-7s live %4zu, free %4zu, peak %4zu, created %6zu, reused %6zu\n",
+			prefab_names[i], stats.live, stats.free, stats.peak_live, stats.created, stats.reused);
+	}
+}
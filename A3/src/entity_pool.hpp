@@ -0,0 +1,51 @@
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include "components.hpp"
+#include "tiny_ecs.hpp"
+
+// Recycles the entities of one prefab. Released entities lose their components (the containers
+// keep the freed slots and hash map nodes) and their id is handed out again by the next acquire,
+// so steady spawn/despawn churn does not allocate.
+class EntityPool
+{
+public:
+	struct Stats {
+		size_t live = 0;       // acquired and not yet released
+		size_t free = 0;       // waiting to be re-used
+		size_t peak_live = 0;  // most entities alive at once, a good reserve() size
+		size_t created = 0;    // brand new entities, each one grew the pool
+		size_t reused = 0;     // acquires served from the free list
+	};
+
+	EntityPool(PREFAB_ID prefab) : prefab(prefab) {}
+
+	// Returns a recycled entity if possible, tagged with the Pooled component of this prefab
+	Entity acquire();
+
+	// Removes all components of the entity and keeps it for the next acquire
+	void release(Entity entity);
+
+	// Keeps the entity for the next acquire, the caller removes its components (see ECSRegistry::apply_deferred)
+	void recycle(Entity entity);
+
+	// Make room for n free entities so that releasing does not grow the free list
+	void reserve(size_t n) { free_entities.reserve(n); }
+
+	const Stats& stats() const { return pool_stats; }
+
+private:
+	PREFAB_ID prefab;
+	std::vector<Entity> free_entities;
+	Stats pool_stats;
+};
+
+extern std::array<EntityPool, prefab_count> entity_pools;
+
+// Returns the entity to its pool if it has one, otherwise removes it for good
+void destroyEntity(Entity entity);
+
+// Debugging for pool sizes
+void printEntityPoolStats();
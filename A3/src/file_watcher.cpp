@@ -0,0 +1,106 @@
+// internal
+#include "file_watcher.hpp"
+
+// stlib
+#include <algorithm>
+#include <chrono>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+// How long the watcher sleeps before it looks at stopping again
+const int WATCH_INTERVAL_MS = 250;
+
+FileWatcher::~FileWatcher()
+{
+	stop();
+}
+
+bool FileWatcher::start(const std::string& directory_arg, const std::vector<std::string>& file_names_arg, std::function<void(const std::string&)> on_change_arg)
+{
+	stop();
+	directory = directory_arg;
+	file_names = file_names_arg;
+	on_change = on_change_arg;
+#ifdef __linux__
+	inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (inotify_fd < 0)
+		return false;
+	if (inotify_add_watch(inotify_fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+		close(inotify_fd);
+		inotify_fd = -1;
+		return false;
+	}
+#else
+	struct stat directory_stat;
+	if (stat(directory.c_str(), &directory_stat) != 0)
+		return false;
+#endif
+	stopping = false;
+	thread = std::thread([this]() { loop(); });
+	return true;
+}
+
+void FileWatcher::stop()
+{
+	if (!thread.joinable())
+		return;
+	stopping = true;
+	thread.join();
+#ifdef __linux__
+	close(inotify_fd);
+	inotify_fd = -1;
+#endif
+}
+
+#ifdef __linux__
+
+void FileWatcher::loop()
+{
+	while (!stopping) {
+		pollfd readable = { inotify_fd, POLLIN, 0 };
+		if (poll(&readable, 1, WATCH_INTERVAL_MS) <= 0)
+			continue;
+		alignas(inotify_event) char buffer[4096];
+		ssize_t length = read(inotify_fd, buffer, sizeof(buffer));
+		for (ssize_t offset = 0; offset < length; ) {
+			const inotify_event* event = (const inotify_event*)(buffer + offset);
+			offset += sizeof(inotify_event) + event->len;
+			if (event->len > 0 && std::find(file_names.begin(), file_names.end(), std::string(event->name)) != file_names.end())
+				on_change(event->name);
+		}
+	}
+}
+
+#else
+
+static long long modification_time(const std::string& path)
+{
+	struct stat file_stat;
+	return stat(path.c_str(), &file_stat) == 0 ? (long long)file_stat.st_mtime : -1;
+}
+
+void FileWatcher::loop()
+{
+	std::vector<long long> times;
+	for (const std::string& name : file_names)
+		times.push_back(modification_time(directory + "/" + name));
+	while (!stopping) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(WATCH_INTERVAL_MS));
+		for (size_t i = 0; i < file_names.size(); i++) {
+			long long time = modification_time(directory + "/" + file_names[i]);
+			if (time != times[i]) {
+				times[i] = time;
+				if (time >= 0)
+					on_change(file_names[i]);
+			}
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,34 @@
+#pragma once
+
+// stlib
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Watches some files of a directory on a thread of its own and calls on_change with the name of a file
+// whenever it was written. Uses inotify on Linux, elsewhere it compares modification times 4 times a second.
+// Editors that save through a temporary file and a rename are seen as well.
+class FileWatcher
+{
+public:
+	FileWatcher() {}
+	~FileWatcher();
+	FileWatcher(const FileWatcher&) = delete;
+	FileWatcher& operator=(const FileWatcher&) = delete;
+
+	// on_change runs on the watcher thread, false if the directory can't be watched
+	bool start(const std::string& directory, const std::vector<std::string>& file_names, std::function<void(const std::string&)> on_change);
+	void stop();
+
+private:
+	void loop();
+
+	std::string directory;
+	std::vector<std::string> file_names;
+	std::function<void(const std::string&)> on_change;
+	std::atomic<bool> stopping{ false };
+	std::thread thread;
+	int inotify_fd = -1;
+};
@@ -0,0 +1,209 @@
+// internal
+#include "flocking_system.hpp"
+#include "profiler.hpp"
+#include "thread_pool.hpp"
+
+// stlib
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+using Clock = std::chrono::high_resolution_clock;
+
+// Flocking configuration
+const int MAX_NEIGHBOURS = 16;
+const int MAX_GRID_CELLS_PER_AXIS = 512;
+const size_t AGENTS_PER_JOB = 256;
+const float SEPARATION_WEIGHT = 8000.f;
+const float ALIGNMENT_WEIGHT = 1.5f;
+const float COHESION_WEIGHT = 1.f;
+const float MIGRATION_WEIGHT = 0.5f; // keeps the school swimming upstream
+const vec2 MIGRATION_VELOCITY = { -150.f, 0.f };
+const float MIN_SPEED = 100.f;
+const float MAX_SPEED = 300.f;
+
+static float ms_since(Clock::time_point start)
+{
+	return (float)(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start)).count() / 1000;
+}
+
+// The grid changes size with the flock's bounding box, reserve the largest one so that it never reallocates
+FlockingSystem::FlockingSystem()
+{
+	size_t max_cells = (size_t)(MAX_GRID_CELLS_PER_AXIS + 1) * (MAX_GRID_CELLS_PER_AXIS + 1);
+	cell_start.reserve(max_cells + 1);
+	cell_fill.reserve(max_cells);
+}
+
+// Copy what the parallel phases need into flat arrays, so they never touch the hash maps
+void FlockingSystem::gather_agents()
+{
+	ComponentContainer<Flocking>& flock_container = registry.flocks;
+	size_t n = flock_container.size();
+	agent_motions.resize(n);
+	agent_flocks.resize(n);
+	agent_steered.resize(n);
+	positions.resize(n);
+	velocities.resize(n);
+	steering.resize(n);
+
+	cell_size = 1;
+	for (size_t i = 0; i < n; i++) {
+		Entity entity = flock_container.entities[i];
+		Motion& motion = registry.motions.get(entity);
+		agent_motions[i] = &motion;
+		agent_flocks[i] = &flock_container.components[i];
+		agent_steered[i] = !registry.softShells.has(entity) || registry.softShells.get(entity).state == SoftShell::NORMAL;
+		positions[i] = motion.position;
+		velocities[i] = motion.velocity;
+		cell_size = max(cell_size, flock_container.components[i].neighbour_radius);
+	}
+}
+
+// Bucket the agents into cells as large as the biggest neighbour radius, so all
+// neighbours of an agent are found in its own and the 8 surrounding cells
+void FlockingSystem::build_grid()
+{
+	size_t n = positions.size();
+	vec2 min_pos = positions[0];
+	vec2 max_pos = positions[0];
+	for (const vec2& p : positions) {
+		min_pos = min(min_pos, p);
+		max_pos = max(max_pos, p);
+	}
+	grid_origin = min_pos;
+	// Very spread out agents share cells rather than blowing up the grid
+	vec2 extent = max_pos - min_pos;
+	cell_size = max(cell_size, max(extent.x, extent.y) / MAX_GRID_CELLS_PER_AXIS);
+	cells_x = (int)(extent.x / cell_size) + 1;
+	cells_y = (int)(extent.y / cell_size) + 1;
+
+	size_t num_cells = (size_t)cells_x * cells_y;
+	cell_start.assign(num_cells + 1, 0);
+	agent_cell.resize(n);
+	cell_agents.resize(n);
+	for (size_t i = 0; i < n; i++) {
+		ivec2 cell = ivec2((positions[i] - grid_origin) / cell_size);
+		cell = clamp(cell, ivec2(0), ivec2(cells_x - 1, cells_y - 1));
+		agent_cell[i] = cell.y * cells_x + cell.x;
+		cell_start[agent_cell[i] + 1]++;
+	}
+	for (size_t c = 0; c < num_cells; c++)
+		cell_start[c + 1] += cell_start[c];
+	// Scatter in agent order, which keeps every cell sorted and the result deterministic
+	cell_fill.assign(num_cells, 0);
+	for (size_t i = 0; i < n; i++) {
+		unsigned int c = agent_cell[i];
+		cell_agents[cell_start[c] + cell_fill[c]++] = (unsigned int)i;
+	}
+}
+
+void FlockingSystem::compute_steering(size_t begin, size_t end)
+{
+	PROFILE_SCOPE("flocking.steer");
+	for (size_t i = begin; i < end; i++) {
+		if (!agent_steered[i]) {
+			steering[i] = { 0, 0 };
+			continue;
+		}
+		const Flocking& flock = *agent_flocks[i];
+		const vec2 position = positions[i];
+		const float radius_squared = flock.neighbour_radius * flock.neighbour_radius;
+		const float separation_squared = flock.separation_radius * flock.separation_radius;
+		ivec2 cell = ivec2((position - grid_origin) / cell_size);
+		cell = clamp(cell, ivec2(0), ivec2(cells_x - 1, cells_y - 1));
+
+		// The MAX_NEIGHBOURS nearest agents in range, as a max-heap on the distance so that the farthest one is
+		// replaced first. Ties go to the lower index, so the result doesn't depend on the order the cells are scanned.
+		std::pair<float, unsigned int> nearest[MAX_NEIGHBOURS];
+		int count = 0;
+		for (int y = max(cell.y - 1, 0); y <= min(cell.y + 1, cells_y - 1); y++) {
+			for (int x = max(cell.x - 1, 0); x <= min(cell.x + 1, cells_x - 1); x++) {
+				unsigned int c = y * cells_x + x;
+				for (unsigned int k = cell_start[c]; k < cell_start[c + 1]; k++) {
+					unsigned int j = cell_agents[k];
+					if (j == i)
+						continue;
+					vec2 offset = position - positions[j];
+					std::pair<float, unsigned int> neighbour(dot(offset, offset), j);
+					if (neighbour.first >= radius_squared)
+						continue;
+					if (count < MAX_NEIGHBOURS) {
+						nearest[count++] = neighbour;
+						std::push_heap(nearest, nearest + count);
+					}
+					else if (neighbour < nearest[0]) {
+						std::pop_heap(nearest, nearest + count);
+						nearest[count - 1] = neighbour;
+						std::push_heap(nearest, nearest + count);
+					}
+				}
+			}
+		}
+
+		vec2 separation = { 0, 0 };
+		vec2 velocity_sum = { 0, 0 };
+		vec2 position_sum = { 0, 0 };
+		for (int n = 0; n < count; n++) {
+			float dist_squared = nearest[n].first;
+			unsigned int j = nearest[n].second;
+			if (dist_squared < separation_squared && dist_squared > 0)
+				separation += (position - positions[j]) / dist_squared;
+			velocity_sum += velocities[j];
+			position_sum += positions[j];
+		}
+		agent_flocks[i]->neighbour_count = count;
+
+		vec2 force = (MIGRATION_VELOCITY - velocities[i]) * MIGRATION_WEIGHT;
+		if (count > 0) {
+			force += separation * SEPARATION_WEIGHT;
+			force += (velocity_sum / (float)count - velocities[i]) * ALIGNMENT_WEIGHT;
+			force += (position_sum / (float)count - position) * COHESION_WEIGHT;
+		}
+		steering[i] = force;
+	}
+}
+
+void FlockingSystem::integrate(size_t begin, size_t end, float step_seconds)
+{
+	for (size_t i = begin; i < end; i++) {
+		if (!agent_steered[i])
+			continue;
+		vec2 velocity = velocities[i] + steering[i] * step_seconds;
+		float speed = length(velocity);
+		if (speed > MAX_SPEED)
+			velocity *= MAX_SPEED / speed;
+		else if (speed < MIN_SPEED && speed > 0)
+			velocity *= MIN_SPEED / speed;
+		agent_motions[i]->velocity = velocity;
+	}
+}
+
+void FlockingSystem::step(float elapsed_ms)
+{
+	timings = PhaseTimings();
+	if (registry.flocks.size() == 0)
+		return;
+	float step_seconds = elapsed_ms / 1000.f;
+
+	auto t = Clock::now();
+	gather_agents();
+	timings.gather_ms = ms_since(t);
+
+	t = Clock::now();
+	build_grid();
+	timings.grid_ms = ms_since(t);
+
+	// Every agent only reads the snapshot and writes its own slot, so chunks can run on any thread
+	t = Clock::now();
+	thread_pool.parallel_for(positions.size(), AGENTS_PER_JOB, [this](size_t begin, size_t end) {
+		compute_steering(begin, end);
+	});
+	timings.steer_ms = ms_since(t);
+
+	t = Clock::now();
+	thread_pool.parallel_for(positions.size(), AGENTS_PER_JOB, [this, step_seconds](size_t begin, size_t end) {
+		integrate(begin, end, step_seconds);
+	});
+	timings.integrate_ms = ms_since(t);
+}
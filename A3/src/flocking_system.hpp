@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vector>
+
+#include "common.hpp"
+#include "components.hpp"
+#include "tiny_ecs_registry.hpp"
+
+// Schools fish together with separation, alignment and cohesion (boids).
+// Neighbours are gathered from a uniform grid and capped at the MAX_NEIGHBOURS nearest,
+// so every update is O(n) instead of testing all pairs of fish.
+class FlockingSystem
+{
+public:
+	// Wall-clock time spent in each phase of the last step, in milliseconds
+	struct PhaseTimings {
+		float gather_ms = 0;
+		float grid_ms = 0;
+		float steer_ms = 0;
+		float integrate_ms = 0;
+	};
+
+	FlockingSystem();
+
+	void step(float elapsed_ms);
+
+	const PhaseTimings& last_timings() const { return timings; }
+
+private:
+	void gather_agents();
+	void build_grid();
+	void compute_steering(size_t begin, size_t end);
+	void integrate(size_t begin, size_t end, float step_seconds);
+
+	PhaseTimings timings;
+
+	// Per-agent snapshot, indexed like registry.flocks
+	std::vector<Motion*> agent_motions;
+	std::vector<Flocking*> agent_flocks;
+	std::vector<bool> agent_steered; // fish that are dodging the salmon are left to the AI
+	std::vector<vec2> positions;
+	std::vector<vec2> velocities;
+	std::vector<vec2> steering;
+
+	// Uniform grid stored as a counting sort: cell c holds cell_agents[cell_start[c] .. cell_start[c+1])
+	vec2 grid_origin = { 0, 0 };
+	float cell_size = 1;
+	int cells_x = 0;
+	int cells_y = 0;
+	std::vector<unsigned int> agent_cell;
+	std::vector<unsigned int> cell_start;
+	std::vector<unsigned int> cell_fill;
+	std::vector<unsigned int> cell_agents;
+};
@@ -0,0 +1,57 @@
+// internal
+#include "frame_arena.hpp"
+
+// stlib
+#include <algorithm>
+#include <assert.h>
+#include <cstddef>
+#include <new>
+
+FrameArena frame_arena;
+
+FrameArena::FrameArena(size_t initial_bytes)
+	: block((unsigned char*)::operator new(initial_bytes))
+	, block_size(initial_bytes)
+{
+}
+
+FrameArena::~FrameArena()
+{
+	reset();
+	::operator delete(block);
+}
+
+void* FrameArena::allocate(size_t bytes, size_t alignment)
+{
+	assert(alignment > 0 && (alignment & (alignment - 1)) == 0 && "Alignment must be a power of two");
+	size_t offset = (block_used + alignment - 1) & ~(alignment - 1);
+	if (offset + bytes <= block_size) {
+		block_used = offset + bytes;
+		peak_used = std::max(peak_used, used());
+		return block + offset;
+	}
+	// Out of room, the heap blocks are aligned for any fundamental type
+	assert(alignment <= alignof(std::max_align_t));
+	void* p = ::operator new(bytes);
+	overflow_blocks.push_back(p);
+	overflow_used += bytes;
+	peak_used = std::max(peak_used, used());
+	return p;
+}
+
+void FrameArena::reset()
+{
+	if (!overflow_blocks.empty()) {
+		for (void* p : overflow_blocks)
+			::operator delete(p);
+		overflow_blocks.clear();
+		// Make the next frame like this one fit into the block, with some head room
+		size_t new_size = (block_used + overflow_used) * 3 / 2;
+		::operator delete(block);
+		block = (unsigned char*)::operator new(new_size);
+		block_size = new_size;
+	}
+	block_used = 0;
+	overflow_used = 0;
+	resets++;
+}
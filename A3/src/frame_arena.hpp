@@ -0,0 +1,67 @@
+#pragma once
+
+// stlib
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Linear allocator for data that only lives until the end of the frame: allocating bumps an
+// offset into one block, freeing does nothing and reset() at the end of the frame makes the whole
+// block available again. When a frame needs more than the block holds the extra memory comes from
+// the heap, and the next reset() grows the block to that frame's total so it fits from then on.
+// Not thread safe: systems may allocate from it on any thread, but only if they declare write access to
+// SharedResource::FRAME_ARENA, so that the scheduler never runs two of them at the same time.
+class FrameArena
+{
+public:
+	explicit FrameArena(size_t initial_bytes = 1 << 20);
+	~FrameArena();
+	FrameArena(const FrameArena&) = delete; // allocators point to it
+	FrameArena& operator=(const FrameArena&) = delete;
+
+	void* allocate(size_t bytes, size_t alignment);
+
+	// Frees everything allocated since the last reset, anything still pointing into the arena dangles
+	void reset();
+
+	size_t used() const { return block_used + overflow_used; }
+	size_t capacity() const { return block_size; }
+	size_t peak() const { return peak_used; }
+	// Number of reset()s so far, to check that frame data is not kept across frames
+	unsigned int generation() const { return resets; }
+
+private:
+	unsigned char* block = nullptr;
+	size_t block_size = 0;
+	size_t block_used = 0;
+	std::vector<void*> overflow_blocks;
+	size_t overflow_used = 0;
+	size_t peak_used = 0;
+	unsigned int resets = 0;
+};
+
+extern FrameArena frame_arena;
+
+// STL allocator that takes its memory from a FrameArena, e.g. FrameVector
+template <typename T>
+struct ArenaAllocator
+{
+	typedef T value_type;
+	FrameArena* arena;
+
+	ArenaAllocator(FrameArena* arena = &frame_arena) : arena(arena) {}
+	template <typename U>
+	ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+	T* allocate(size_t n) { return (T*)arena->allocate(n * sizeof(T), alignof(T)); }
+	void deallocate(T*, size_t) {} // released all at once by FrameArena::reset
+
+	template <typename U>
+	bool operator==(const ArenaAllocator<U>& other) const { return arena == other.arena; }
+	template <typename U>
+	bool operator!=(const ArenaAllocator<U>& other) const { return arena != other.arena; }
+};
+
+// A vector for one frame, create it during the frame and let it go before the arena is reset
+template <typename T>
+using FrameVector = std::vector<T, ArenaAllocator<T>>;
@@ -0,0 +1,123 @@
+// internal
+#include "game_config.hpp"
+#include "file_watcher.hpp"
+
+// stlib
+#include <errno.h>
+#include <fstream>
+#include <math.h>
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+
+GameConfig game_config;
+
+// The keys of the config file, one of the two members is set
+struct ConfigKey
+{
+	const char* name;
+	size_t GameConfig::* count;
+	float GameConfig::* value;
+	bool positive; // delays of 0 would spawn without end
+};
+
+static const ConfigKey CONFIG_KEYS[] = {
+	{ "max_turtles", &GameConfig::max_turtles, nullptr, false },
+	{ "max_fish", &GameConfig::max_fish, nullptr, false },
+	{ "turtle_delay_ms", nullptr, &GameConfig::turtle_delay_ms, true },
+	{ "fish_delay_ms", nullptr, &GameConfig::fish_delay_ms, true },
+	{ "pebble_delay_ms", nullptr, &GameConfig::pebble_delay_ms, true },
+	{ "swimming_acceleration", nullptr, &GameConfig::swimming_acceleration, false },
+	{ "salmon_mass", nullptr, &GameConfig::salmon_mass, true },
+	{ "salmon_drag_area", nullptr, &GameConfig::salmon_drag_area, false },
+	{ "drag_coefficient", nullptr, &GameConfig::drag_coefficient, false },
+	{ "flow_drag_coefficient", nullptr, &GameConfig::flow_drag_coefficient, false },
+	{ "water_density", nullptr, &GameConfig::water_density, false },
+	{ "water_flow_speed", nullptr, &GameConfig::water_flow_speed, false },
+	{ "pebble_gravity", nullptr, &GameConfig::pebble_gravity, false },
+	{ "pebble_floor_restitution", nullptr, &GameConfig::pebble_floor_restitution, false },
+	{ "penetration_scaling", nullptr, &GameConfig::penetration_scaling, true },
+};
+
+static std::string trim(const std::string& text)
+{
+	size_t begin = text.find_first_not_of(" \t\r");
+	if (begin == std::string::npos)
+		return "";
+	return text.substr(begin, text.find_last_not_of(" \t\r") - begin + 1);
+}
+
+bool loadGameConfig(const std::string& path, GameConfig& config)
+{
+	std::ifstream file(path);
+	if (!file.good())
+		return false;
+	std::string line;
+	for (int line_number = 1; std::getline(file, line); line_number++) {
+		line = trim(line.substr(0, line.find('#')));
+		if (line.empty())
+			continue;
+		size_t equals = line.find('=');
+		std::string name = trim(line.substr(0, equals));
+		std::string text = equals == std::string::npos ? "" : trim(line.substr(equals + 1));
+		const ConfigKey* key = nullptr;
+		for (const ConfigKey& candidate : CONFIG_KEYS)
+			if (name == candidate.name)
+				key = &candidate;
+		if (key == nullptr) {
+			fprintf(stderr, "%s:%d: unknown key '%s'\n", path.c_str(), line_number, name.c_str());
+			continue;
+		}
+		char* end = nullptr;
+		errno = 0;
+		double value = strtod(text.c_str(), &end);
+		bool is_valid = !text.empty() && *end == '\0' && errno == 0;
+		if (key->positive)
+			is_valid = is_valid && value > 0;
+		if (key->count != nullptr)
+			is_valid = is_valid && value >= 0 && value < 1e12 && value == floor(value);
+		if (!is_valid) {
+			fprintf(stderr, "%s:%d: '%s' is not a valid %s\n", path.c_str(), line_number, text.c_str(), name.c_str());
+			continue;
+		}
+		if (key->count != nullptr)
+			config.*key->count = (size_t)value;
+		else
+			config.*key->value = (float)value;
+	}
+	return true;
+}
+
+static std::mutex reload_mutex;
+static GameConfig reloaded_config;
+static bool has_reloaded_config = false;
+// Declared last so that it stops before the others are destroyed at exit
+static FileWatcher config_watcher;
+
+void watchGameConfig(const std::string& path)
+{
+	size_t slash = path.find_last_of("/\\");
+	std::string directory = slash == std::string::npos ? "." : path.substr(0, slash);
+	std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+	bool is_watched = config_watcher.start(directory, { name }, [path](const std::string&) {
+		// A key left out of the edited file goes back to its default
+		GameConfig config;
+		if (!loadGameConfig(path, config))
+			return;
+		std::lock_guard<std::mutex> lock(reload_mutex);
+		reloaded_config = config;
+		has_reloaded_config = true;
+	});
+	if (!is_watched)
+		fprintf(stderr, "Could not watch %s, edits need a restart\n", path.c_str());
+}
+
+bool applyGameConfigChanges()
+{
+	std::lock_guard<std::mutex> lock(reload_mutex);
+	if (!has_reloaded_config)
+		return false;
+	game_config = reloaded_config;
+	has_reloaded_config = false;
+	return true;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+// stlib
+#include <stddef.h>
+#include <string>
+
+// Spawn rates, population caps and physics constants, read at startup from data/config.txt or the file in
+// the GAME_CONFIG environment variable. The file has "key = value" lines and # comments, left out keys keep
+// the defaults below. It is watched while the game runs, an edit takes effect at the start of the next frame.
+struct GameConfig
+{
+	// Spawning, a delay is the average time between two spawns
+	size_t max_turtles = 15;
+	size_t max_fish = 5;
+	float turtle_delay_ms = 18000.f;
+	float fish_delay_ms = 15000.f;
+	float pebble_delay_ms = 1000.f;
+
+	// Physics
+	float swimming_acceleration = 250.f;
+	float salmon_mass = 8.f;               // kg
+	float salmon_drag_area = 0.0323584f;   // m^2, a salmon of radius 3"
+	float drag_coefficient = 0.4f;         // of the salmon and the pebbles moving through the water
+	float flow_drag_coefficient = 0.5f;    // of the pebbles in the flowing water (a sphere)
+	float water_density = 1000.f;          // kg/m^3
+	float water_flow_speed = 0.3f;         // m/s
+	float pebble_gravity = 490.f;          // units/s^2, about 1/10 of the real one or pebbles sink right away
+	float pebble_floor_restitution = 0.3f; // share of the speed a pebble keeps when it bounces off the bottom
+	float penetration_scaling = 10.f;      // fish/turtle overlaps are resolved by 1/penetration_scaling per step
+};
+
+extern GameConfig game_config;
+
+// Reads a config file over the given values, false if it can't be opened. Unknown keys and bad values are reported and skipped
+bool loadGameConfig(const std::string& path, GameConfig& config);
+
+// Watches the file that was loaded, edits are read on the watcher thread and kept until applied
+void watchGameConfig(const std::string& path);
+
+// Makes the last edit of the file the current game_config, call it while no system runs. True if there was one
+bool applyGameConfigChanges();
@@ -0,0 +1,107 @@
+// internal
+#include "gpu_timer.hpp"
+#include "profiler.hpp"
+
+void GpuTimer::init()
+{
+	for (Frame& frame : frames)
+		for (Section& section : frame.sections)
+			glGenQueries(1, &section.query);
+	gl_has_errors();
+	initialized = true;
+}
+
+void GpuTimer::destroy()
+{
+	if (!initialized)
+		return;
+	for (Frame& frame : frames)
+		for (Section& section : frame.sections)
+			glDeleteQueries(1, &section.query);
+	initialized = false;
+}
+
+// Queries finish in order, so once the last one is available all of them are
+bool GpuTimer::collect(Frame& frame)
+{
+	GLint available = 0;
+	glGetQueryObjectiv(frame.sections[frame.used - 1].query, GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available)
+		return false;
+
+	for (int i = 0; i < frame.used; i++) {
+		const Section& section = frame.sections[i];
+		GLuint64 elapsed_ns = 0;
+		glGetQueryObjectui64v(section.query, GL_QUERY_RESULT, &elapsed_ns);
+		last_results[i] = { section.pass, section.group, elapsed_ns / 1000000.f };
+	}
+	last_used = frame.used;
+	frame.pending = false;
+	return true;
+}
+
+// One GPU frame per profiler frame: the newest one that finished, or the last one again when none did
+void GpuTimer::report()
+{
+	float total_ms = 0;
+	for (int i = 0; i < last_used; i++) {
+		const Result& result = last_results[i];
+		profiler.add_sample(result.pass, result.ms);
+		profiler.add_sample(result.group, result.ms);
+		total_ms += result.ms;
+	}
+	if (last_used > 0)
+		profiler.add_sample("gpu", total_ms);
+}
+
+void GpuTimer::begin_frame()
+{
+	if (!initialized)
+		return;
+	for (int k = 1; k <= FRAMES_IN_FLIGHT; k++) {
+		Frame& frame = frames[(current + k) % FRAMES_IN_FLIGHT]; // oldest first, the newest results win
+		if (frame.pending && !collect(frame))
+			break;
+	}
+	report();
+
+	current = (current + 1) % FRAMES_IN_FLIGHT;
+	Frame& frame = frames[current];
+	if (frame.pending) {
+		// The GPU is more than FRAMES_IN_FLIGHT frames behind, don't wait for it
+		dropped++;
+		frame.pending = false;
+	}
+	frame.used = 0;
+}
+
+void GpuTimer::begin_section(const char* pass, const char* group)
+{
+	if (!initialized)
+		return;
+	Frame& frame = frames[current];
+	if (frame.used == MAX_SECTIONS) // out of queries, the open section keeps running
+		return;
+	end_section();
+	Section& section = frame.sections[frame.used++];
+	section.pass = pass;
+	section.group = group;
+	glBeginQuery(GL_TIME_ELAPSED, section.query);
+	section_open = true;
+}
+
+void GpuTimer::end_section()
+{
+	if (!section_open)
+		return;
+	glEndQuery(GL_TIME_ELAPSED);
+	section_open = false;
+}
+
+void GpuTimer::end_frame()
+{
+	if (!initialized)
+		return;
+	end_section();
+	frames[current].pending = frames[current].used > 0;
+}
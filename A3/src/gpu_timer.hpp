@@ -0,0 +1,66 @@
+#pragma once
+
+// stlib
+#include <array>
+
+// internal
+#include "common.hpp"
+
+// Measures GPU time with GL_TIME_ELAPSED queries without stalling the pipeline. A frame is split
+// into consecutive sections (time elapsed queries can't nest), each one belongs to a pass and a
+// group of draw calls. Results are read back once the GPU is done, usually one frame later,
+// and handed to the profiler as "gpu", the pass and the group through add_sample, which is safe to call
+// from the render thread.
+class GpuTimer
+{
+public:
+	static const int FRAMES_IN_FLIGHT = 3;
+	static const int MAX_SECTIONS = 64;
+
+	// Needs a current GL context
+	void init();
+	void destroy();
+
+	// Reports the frames the GPU finished and starts recording a new one
+	void begin_frame();
+
+	// Ends the open section and starts the next one, names must be string literals
+	void begin_section(const char* pass, const char* group);
+	void end_section();
+
+	void end_frame();
+
+	// Frames whose queries were re-used before their results were available
+	size_t dropped_frames() const { return dropped; }
+
+private:
+	struct Section {
+		GLuint query = 0;
+		const char* pass = nullptr;
+		const char* group = nullptr;
+	};
+	struct Frame {
+		std::array<Section, MAX_SECTIONS> sections;
+		int used = 0;
+		bool pending = false; // queries issued, results not read yet
+	};
+
+	struct Result {
+		const char* pass;
+		const char* group;
+		float ms;
+	};
+
+	// False if the GPU isn't done with the frame yet
+	bool collect(Frame& frame);
+	void report();
+
+	std::array<Frame, FRAMES_IN_FLIGHT> frames;
+	int current = 0;
+	bool section_open = false;
+	bool initialized = false;
+	size_t dropped = 0;
+	// Of the newest frame collected
+	std::array<Result, MAX_SECTIONS> last_results;
+	int last_used = 0;
+};
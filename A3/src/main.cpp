@@ -7,23 +7,49 @@
 
 // internal
 #include "ai_system.hpp"
+#include "flocking_system.hpp"
+#include "frame_arena.hpp"
+#include "game_config.hpp"
 #include "physics_system.hpp"
+#include "profiler.hpp"
 #include "render_system.hpp"
+#include "render_thread.hpp"
+#include "scenario.hpp"
+#include "spatial_sort.hpp"
+#include "system_scheduler.hpp"
+#include "thread_pool.hpp"
+#include "world_init.hpp"
 #include "world_system.hpp"
 
 using Clock = std::chrono::high_resolution_clock;
 
 const int window_width_px = 1200;
 const int window_height_px = 800;
+const unsigned int ECS_STATS_EVERY_X_FRAMES = 60;
+const unsigned int SPATIAL_SORT_EVERY_X_FRAMES = 30;
+
+// Samples the registry and frame arena memory as profiler counters, to spot containers that keep growing
+void profile_registry_stats(RegistryStats& stats)
+{
+	registry.collect_stats(stats);
+	profiler.add_counter("ecs.entities", (double)stats.entities);
+	profiler.add_counter("ecs.components", (double)stats.total.count);
+	profiler.add_counter("ecs.capacity", (double)stats.total.capacity);
+	profiler.add_counter("ecs.bytes", (double)stats.total.bytes);
+	profiler.add_counter("frame_arena.peak_bytes", (double)frame_arena.peak());
+}
 
 // Entry point
 int main()
 {
+	auto startup_time = Clock::now();
+
 	// Global systems
 	WorldSystem world;
 	RenderSystem renderer;
 	PhysicsSystem physics;
 	AISystem ai;
+	FlockingSystem flocking;
 
 	// Initializing window
 	GLFWwindow* window = world.create_window(window_width_px, window_height_px);
@@ -34,12 +60,112 @@ int main()
 		return EXIT_FAILURE;
 	}
 
-	// initialize the main systems
-	renderer.init(window_width_px, window_height_px, window);
-	world.init(&renderer);
+	// Spawn rates and physics constants, GAME_CONFIG=file picks another file than data/config.txt
+	const char* config_override = getenv("GAME_CONFIG");
+	std::string config_path = config_override ? config_override : data_path() + "/config.txt";
+	if (loadGameConfig(config_path, game_config))
+		watchGameConfig(config_path);
+	else
+		fprintf(stderr, "Could not read %s, using the default configuration\n", config_path.c_str());
+
+	// SCENARIO="fish=1000 turtles=100 pebbles=500 ticks=600" starts with that population (see scenario.hpp),
+	// steps at a fixed 60 Hz for the given number of ticks, prints the throughput and system timings and exits
+	const char* scenario_text = getenv("SCENARIO");
+	Scenario scenario;
+	if (scenario_text != nullptr) {
+		if (!parseScenario(scenario_text, scenario))
+			return EXIT_FAILURE;
+		world.set_scenario(&scenario);
+	}
+
+	// ASSERT_NO_ALLOCATIONS=1 aborts on the first steady state frame that allocates, with a report of the scopes
+	profiler.assert_no_allocations = getenv("ASSERT_NO_ALLOCATIONS") != nullptr;
+
+	// initialize the main systems, the asset files are decoded on the workers while the main thread
+	// uploads what is ready. SERIAL_LOADING=1 loads them on the main thread only, to compare the startup time.
+	bool serial_loading = getenv("SERIAL_LOADING") != nullptr;
+	thread_pool.init(serial_loading ? 1 : 0);
+	auto loading_time = Clock::now();
+	JobGraph asset_loads;
+	world.load_audio(asset_loads);
+	renderer.init(window_width_px, window_height_px, window, asset_loads);
+	asset_loads.run();
+	float loading_ms = (float)(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - loading_time)).count() / 1000;
+	if (serial_loading)
+		thread_pool.init();
+	if (!world.init(&renderer)) {
+		printf("Press any key to exit");
+		getchar();
+		return EXIT_FAILURE;
+	}
+
+	RegistryStats registry_stats;
+
+	// RENDER_THREAD=1 draws on a thread of its own, while the simulation already does the next step
+	RenderThread render_thread;
+	if (getenv("RENDER_THREAD") != nullptr)
+		render_thread.start(&renderer);
+
+	// The systems of a frame in the order they used to run, each one declares what it reads and writes.
+	// Systems that don't conflict run at the same time, e.g. the timers alongside the AI.
+	float elapsed_ms = 0;
+	SystemScheduler scheduler;
+	SystemScheduler::SystemId world_step = scheduler.add("world",
+		SystemAccess().write_all().on_main_thread(),
+		[&]() { world.step(elapsed_ms); });
+	SystemScheduler::SystemId flocking_step = scheduler.add("flocking",
+		SystemAccess().read(registry.softShells).write(registry.flocks).write(registry.motions),
+		[&]() { flocking.step(elapsed_ms); });
+	SystemScheduler::SystemId physics_step = scheduler.add("physics",
+		SystemAccess().read(registry.players).read(registry.deathTimers).read(registry.meshPtrs).read(registry.softShells)
+			.read(registry.physics).write(registry.motions).write(registry.gravity)
+			.write(registry.collisions).write(SharedResource::ENTITIES).read(SharedResource::DEBUG_FLAGS).write(SharedResource::DEBUG_LINES)
+			.write(SharedResource::FRAME_ARENA),
+		[&]() { physics.step(elapsed_ms, window_width_px, window_height_px, &renderer); });
+	SystemScheduler::SystemId collisions_step = scheduler.add("collisions",
+		SystemAccess().read(registry.players).read(registry.hardShells).read(registry.softShells).write(registry.collisions)
+			.write(registry.deathTimers).write(registry.lightUpTimers).write(registry.motions).write(registry.colors)
+			.write(SharedResource::ENTITIES).write(SharedResource::AUDIO),
+		[&]() { world.handle_collisions(); });
+	// Sync point, apply the destroys, inserts and removes the systems queued above
+	scheduler.add("apply_deferred",
+		SystemAccess().write_all(),
+		[&]() { registry.apply_deferred(); });
+	// Puts the motions, physics and gravity of entities that are close in the world next to each other in memory,
+	// between the sync point and the next physics step nothing holds an index into them
+	scheduler.add("spatial_sort",
+		SystemAccess().write(registry.motions).write(registry.physics).write(registry.gravity),
+		[&]() {
+			if (profiler.frame() % SPATIAL_SORT_EVERY_X_FRAMES == 0)
+				sortSpatially({ (float)window_width_px, (float)window_height_px });
+		});
+	SystemScheduler::SystemId timers_step = scheduler.add("timers",
+		SystemAccess().write(registry.deathTimers).write(registry.lightUpTimers).write(registry.screenStates),
+		[&]() { world.update_timers(elapsed_ms); });
+	scheduler.add("ai",
+		SystemAccess().read(registry.players).write(registry.motions).write(registry.softShells)
+			.write(SharedResource::DEBUG_FLAGS).write(SharedResource::DEBUG_LINES).write(SharedResource::FRAME_ARENA),
+		[&]() { ai.step(elapsed_ms, window_width_px, window_height_px); });
+	scheduler.add("debug_lines",
+		SystemAccess().write(registry.motions).write(registry.renderRequests).write(registry.debugComponents)
+			.write(SharedResource::ENTITIES).write(SharedResource::DEBUG_LINES).read(SharedResource::FRAME_ARENA),
+		[&]() { flushDebugLines(); });
+	scheduler.add("render",
+		SystemAccess().read(registry.renderRequests).read(registry.motions).read(registry.colors).read(registry.lightUpTimers)
+			.read(registry.screenStates).read(SharedResource::DEBUG_FLAGS).on_main_thread(),
+		[&]() {
+			if (render_thread.is_running()) {
+				renderer.capture(render_thread.next_snapshot());
+				render_thread.publish();
+			}
+			else
+				renderer.draw();
+		});
 
 	// variable timestep loop
 	auto t = Clock::now();
+	auto scenario_start = t;
+	unsigned int scenario_ticks = 0;
 	while (!world.is_over()) {
 		// Processes system messages, if this wasn't present the window would become
 		// unresponsive
@@ -47,21 +173,47 @@ int main()
 
 		// Calculating elapsed times in milliseconds from the previous iteration
 		auto now = Clock::now();
-		float elapsed_ms =
+		elapsed_ms =
 			(float)(std::chrono::duration_cast<std::chrono::microseconds>(now - t)).count() / 1000;
 		t = now;
+		if (scenario_text != nullptr)
+			elapsed_ms = 1000.f / 60.f; // the same simulation at any frame rate
 
-		if (!debugging.in_freeze_mode) {
-			world.step(elapsed_ms);
-			physics.step(elapsed_ms, window_width_px, window_height_px, &renderer);
-			world.handle_collisions();
+		// An edited config file takes effect between two frames, while no system reads it
+		if (applyGameConfigChanges())
+			printf("Reloaded %s\n", config_path.c_str());
+
+		{
+			PROFILE_SCOPE("frame");
+			// The simulation stands still in freeze mode, the AI and the rendering go on
+			for (SystemScheduler::SystemId system : { world_step, flocking_step, physics_step, collisions_step, timers_step })
+				scheduler.set_enabled(system, !debugging.in_freeze_mode);
+			scheduler.run();
+		}
+		if (profiler.frame() % ECS_STATS_EVERY_X_FRAMES == 0)
+			profile_registry_stats(registry_stats);
+		// Everything allocated for this frame is released at once
+		frame_arena.reset();
+		profiler.end_frame();
+
+		if (profiler.frame() == 1) {
+			float first_frame_ms = (float)(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - startup_time)).count() / 1000;
+			printf("Time to first frame: %.1f ms (asset loading %.1f ms%s)\n", first_frame_ms, loading_ms, serial_loading ? ", serial" : "");
 		}
-		ai.step(elapsed_ms, window_width_px, window_height_px);
 
-		renderer.draw();
+		if (scenario_text != nullptr && ++scenario_ticks == scenario.ticks) {
+			double wall_ms = (double)(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - scenario_start)).count() / 1000;
+			std::vector<const char*> scopes = { "frame" };
+			for (SystemScheduler::SystemId system = 0; system < scheduler.size(); system++)
+				scopes.push_back(scheduler.name(system));
+			printScenarioReport(scenario, scenario_ticks, wall_ms, scopes);
+			break;
+		}
 
 		// TODO A2: you can implement the debug freeze here but other places are possible too.
 	}
+	// The renderer frees its GL objects on the main thread
+	render_thread.stop();
 
 	return EXIT_SUCCESS;
 }
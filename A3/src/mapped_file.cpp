@@ -0,0 +1,99 @@
+// internal
+#include "mapped_file.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string& path)
+{
+	close();
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size)) {
+		CloseHandle(file);
+		return false;
+	}
+	file_handle = file;
+	mapped_size = (size_t)file_size.QuadPart;
+	if (mapped_size == 0)
+		return true;
+	mapping_handle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping_handle != nullptr)
+		mapped = (const unsigned char*)MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0);
+	if (mapped == nullptr) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (mapped)
+		UnmapViewOfFile(mapped);
+	if (mapping_handle)
+		CloseHandle(mapping_handle);
+	if (file_handle)
+		CloseHandle(file_handle);
+	mapped = nullptr;
+	mapped_size = 0;
+	mapping_handle = nullptr;
+	file_handle = nullptr;
+}
+
+#else
+
+bool MappedFile::open(const std::string& path)
+{
+	close();
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat file_stat;
+	if (fstat(fd, &file_stat) != 0) {
+		::close(fd);
+		return false;
+	}
+	mapped_size = (size_t)file_stat.st_size;
+	if (mapped_size > 0) {
+		void* p = mmap(nullptr, mapped_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (p == MAP_FAILED) {
+			::close(fd);
+			mapped_size = 0;
+			return false;
+		}
+		// Parsers read front to back
+		madvise(p, mapped_size, MADV_SEQUENTIAL);
+		mapped = (const unsigned char*)p;
+	}
+	// The mapping keeps the file alive
+	::close(fd);
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (mapped)
+		munmap((void*)mapped, mapped_size);
+	mapped = nullptr;
+	mapped_size = 0;
+}
+
+#endif
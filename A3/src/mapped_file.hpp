@@ -0,0 +1,31 @@
+#pragma once
+
+// stlib
+#include <stddef.h>
+#include <string>
+
+// A read-only file mapped into memory, the pages are read on first touch and nothing is copied.
+// Closed when it goes out of scope, pointers into data() dangle after that.
+class MappedFile
+{
+public:
+	MappedFile() {}
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// False if the file can't be opened, an empty file opens with size() 0 and no data()
+	bool open(const std::string& path);
+	void close();
+
+	const unsigned char* data() const { return mapped; }
+	size_t size() const { return mapped_size; }
+
+private:
+	const unsigned char* mapped = nullptr;
+	size_t mapped_size = 0;
+#ifdef _WIN32
+	void* file_handle = nullptr;
+	void* mapping_handle = nullptr;
+#endif
+};
@@ -0,0 +1,102 @@
+// internal
+#include "components.hpp"
+#include "mapped_file.hpp"
+
+// stlib
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+// Layout of a mesh cache file: this header, vertex_count ColoredVertex and index_count indices,
+// exactly as they are in memory. The vertices are already normalized, the size before normalizing
+// is stored in the header. Native byte order, the cache is made on the machine that uses it.
+struct MeshCacheHeader
+{
+	char magic[4];        // "MESH"
+	uint32_t version;
+	uint32_t vertex_size; // sizeof(ColoredVertex), a different layout invalidates the cache
+	uint32_t index_size;
+	uint32_t vertex_count;
+	uint32_t index_count;
+	int64_t source_mtime; // of the OBJ file the cache was made from, to notice when it changes
+	uint64_t source_size;
+	float original_size[2];
+};
+
+const uint32_t MESH_CACHE_VERSION = 2;
+
+static bool is_valid_cache(const MappedFile& cache, const struct stat* source, MeshCacheHeader& header)
+{
+	if (cache.size() < sizeof(MeshCacheHeader))
+		return false;
+	memcpy(&header, cache.data(), sizeof(MeshCacheHeader));
+	if (memcmp(header.magic, "MESH", 4) != 0 || header.version != MESH_CACHE_VERSION ||
+		header.vertex_size != sizeof(ColoredVertex) || header.index_size != sizeof(uint32_t))
+		return false;
+	// Without the OBJ file any cache goes, e.g. when only the cache is shipped
+	if (source && (header.source_mtime != (int64_t)source->st_mtime || header.source_size != (uint64_t)source->st_size))
+		return false;
+	return cache.size() == sizeof(MeshCacheHeader) + header.vertex_count * sizeof(ColoredVertex) + header.index_count * sizeof(uint32_t);
+}
+
+static void write_cache(const std::string& cache_path, const struct stat& source,
+	const std::vector<ColoredVertex>& vertices, const std::vector<uint32_t>& vertex_indices, vec2 size)
+{
+	MeshCacheHeader header;
+	memcpy(header.magic, "MESH", 4);
+	header.version = MESH_CACHE_VERSION;
+	header.vertex_size = sizeof(ColoredVertex);
+	header.index_size = sizeof(uint32_t);
+	header.vertex_count = (uint32_t)vertices.size();
+	header.index_count = (uint32_t)vertex_indices.size();
+	header.source_mtime = (int64_t)source.st_mtime;
+	header.source_size = (uint64_t)source.st_size;
+	header.original_size[0] = size.x;
+	header.original_size[1] = size.y;
+
+	// Written next to it and renamed, so that a crash never leaves a half written cache behind
+	std::string temp_path = cache_path + ".tmp";
+	FILE* file = fopen(temp_path.c_str(), "wb");
+	if (file == NULL) {
+		fprintf(stderr, "Could not write the mesh cache %s\n", cache_path.c_str());
+		return;
+	}
+	bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+	if (!vertices.empty())
+		written = written && fwrite(vertices.data(), sizeof(ColoredVertex), vertices.size(), file) == vertices.size();
+	if (!vertex_indices.empty())
+		written = written && fwrite(vertex_indices.data(), sizeof(uint32_t), vertex_indices.size(), file) == vertex_indices.size();
+	written = fclose(file) == 0 && written;
+	remove(cache_path.c_str()); // rename doesn't replace files on Windows
+	if (!written || rename(temp_path.c_str(), cache_path.c_str()) != 0) {
+		fprintf(stderr, "Could not write the mesh cache %s\n", cache_path.c_str());
+		remove(temp_path.c_str());
+	}
+}
+
+bool Mesh::loadCached(std::string obj_path, std::vector<ColoredVertex>& out_vertices, std::vector<uint32_t>& out_vertex_indices, vec2& out_size)
+{
+	struct stat source;
+	bool has_source = stat(obj_path.c_str(), &source) == 0;
+	std::string cache_path = obj_path + ".bin";
+
+	MappedFile cache;
+	MeshCacheHeader header;
+	if (cache.open(cache_path) && is_valid_cache(cache, has_source ? &source : nullptr, header)) {
+		const ColoredVertex* vertices = (const ColoredVertex*)(cache.data() + sizeof(MeshCacheHeader));
+		const uint32_t* indices = (const uint32_t*)(vertices + header.vertex_count);
+		out_vertices.assign(vertices, vertices + header.vertex_count);
+		out_vertex_indices.assign(indices, indices + header.index_count);
+		out_size = { header.original_size[0], header.original_size[1] };
+		return true;
+	}
+	cache.close();
+
+	if (!loadFromOBJFile(obj_path, out_vertices, out_vertex_indices, out_size))
+		return false;
+	if (has_source)
+		write_cache(cache_path, source, out_vertices, out_vertex_indices, out_size);
+	return true;
+}
@@ -0,0 +1,238 @@
+// internal
+#include "obj_parser.hpp"
+
+// stlib
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+// strtof and sscanf look up the locale and are built for any input; OBJ numbers are plain decimals,
+// so the tokens are read by hand, straight from the file's memory
+
+static bool is_blank(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+static bool is_digit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+static void skip_blanks(const char*& p, const char* end)
+{
+	while (p < end && is_blank(*p))
+		p++;
+}
+
+// The powers of ten that are exact in a double
+static const double EXACT_POWERS_OF_TEN[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static double power_of_ten(int exponent)
+{
+	return exponent <= 22 ? EXACT_POWERS_OF_TEN[exponent] : pow(10.0, exponent);
+}
+
+// [+-]digits[.digits][(e|E)[+-]digits], at most 19 significant digits are kept, which is far more than a float holds
+static bool parse_float(const char*& p, const char* end, float& out)
+{
+	const char* start = p;
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+')) {
+		negative = *p == '-';
+		p++;
+	}
+	uint64_t mantissa = 0;
+	int significant_digits = 0;
+	int exponent = 0;
+	bool has_digits = false;
+	for (; p < end && is_digit(*p); p++) {
+		has_digits = true;
+		if (significant_digits < 19) {
+			mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+			if (mantissa != 0)
+				significant_digits++;
+		}
+		else
+			exponent++;
+	}
+	if (p < end && *p == '.') {
+		p++;
+		for (; p < end && is_digit(*p); p++) {
+			has_digits = true;
+			if (significant_digits < 19) {
+				mantissa = mantissa * 10 + (uint64_t)(*p - '0');
+				if (mantissa != 0)
+					significant_digits++;
+				exponent--;
+			}
+		}
+	}
+	if (!has_digits) {
+		p = start;
+		return false;
+	}
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		const char* e = p + 1;
+		bool negative_exponent = false;
+		if (e < end && (*e == '-' || *e == '+')) {
+			negative_exponent = *e == '-';
+			e++;
+		}
+		if (e < end && is_digit(*e)) {
+			int value = 0;
+			for (; e < end && is_digit(*e); e++)
+				if (value < 10000)
+					value = value * 10 + (*e - '0');
+			exponent += negative_exponent ? -value : value;
+			p = e;
+		}
+	}
+	double value = (double)mantissa;
+	if (exponent < 0)
+		value /= power_of_ten(-exponent);
+	else if (exponent > 0)
+		value *= power_of_ten(exponent);
+	out = (float)(negative ? -value : value);
+	return true;
+}
+
+static bool parse_int(const char*& p, const char* end, int64_t& out)
+{
+	const char* start = p;
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+')) {
+		negative = *p == '-';
+		p++;
+	}
+	if (p == end || !is_digit(*p)) {
+		p = start;
+		return false;
+	}
+	int64_t value = 0;
+	for (; p < end && is_digit(*p); p++)
+		if (value < ((int64_t)1 << 40)) // far beyond any index, only keeps it from overflowing
+			value = value * 10 + (*p - '0');
+	out = negative ? -value : value;
+	return true;
+}
+
+static const char* line_end(const char* p, const char* end)
+{
+	const char* newline = (const char*)memchr(p, '\n', (size_t)(end - p));
+	return newline ? newline : end;
+}
+
+// Whether the line starts with the given keyword, e.g. "v" matches "v 1 2 3" but not "vt 1 2"
+static bool starts_with_keyword(const char* p, const char* end, char keyword)
+{
+	return end - p >= 2 && p[0] == keyword && is_blank(p[1]);
+}
+
+bool parseOBJ(const char* text, size_t length, std::vector<ColoredVertex>& out_vertices, std::vector<uint32_t>& out_vertex_indices, std::string& out_error)
+{
+	const char* end = text + length;
+	char error[128];
+
+	// Counting pass, a face with n corners makes n - 2 triangles
+	size_t vertex_count = 0;
+	size_t triangle_count = 0;
+	for (const char* p = text; p < end; ) {
+		const char* eol = line_end(p, end);
+		skip_blanks(p, eol);
+		if (starts_with_keyword(p, eol, 'v'))
+			vertex_count++;
+		else if (starts_with_keyword(p, eol, 'f')) {
+			size_t corners = 0;
+			for (p++; p < eol; ) {
+				skip_blanks(p, eol);
+				if (p == eol)
+					break;
+				corners++;
+				while (p < eol && !is_blank(*p))
+					p++;
+			}
+			if (corners >= 3)
+				triangle_count += corners - 2;
+		}
+		p = eol + 1;
+	}
+	out_vertices.clear();
+	out_vertex_indices.clear();
+	out_error.clear();
+	out_vertices.reserve(vertex_count);
+	out_vertex_indices.reserve(triangle_count * 3);
+
+	int line = 1;
+	for (const char* p = text; p < end; line++) {
+		const char* eol = line_end(p, end);
+		skip_blanks(p, eol);
+		if (starts_with_keyword(p, eol, 'v')) {
+			p++;
+			ColoredVertex vertex;
+			float* values[6] = { &vertex.position.x, &vertex.position.y, &vertex.position.z,
+			                     &vertex.color.x, &vertex.color.y, &vertex.color.z };
+			int count = 0;
+			for (; count < 6; count++) {
+				skip_blanks(p, eol);
+				if (!parse_float(p, eol, *values[count]))
+					break;
+			}
+			if (count == 3)
+				vertex.color = { 1.f, 1.f, 1.f };
+			else if (count != 6) {
+				snprintf(error, sizeof(error), "line %d: a vertex needs 3 coordinates and optionally 3 color values", line);
+				out_error = error;
+				return false;
+			}
+			out_vertices.push_back(vertex);
+		}
+		else if (starts_with_keyword(p, eol, 'f')) {
+			p++;
+			uint32_t first = 0, previous = 0;
+			int corners = 0;
+			while (true) {
+				skip_blanks(p, eol);
+				if (p == eol)
+					break;
+				int64_t index;
+				if (!parse_int(p, eol, index) || (p < eol && !is_blank(*p) && *p != '/')) {
+					snprintf(error, sizeof(error), "line %d: a face corner must be v, v/vt, v//vn or v/vt/vn", line);
+					out_error = error;
+					return false;
+				}
+				// The texture coordinate and normal indices aren't used
+				while (p < eol && !is_blank(*p))
+					p++;
+				// OBJ counts from 1, negative indices count back from the last vertex so far
+				int64_t vertex_index = index > 0 ? index - 1 : (int64_t)out_vertices.size() + index;
+				if (index == 0 || vertex_index < 0 || vertex_index >= (int64_t)vertex_count) {
+					snprintf(error, sizeof(error), "line %d: vertex %lld doesn't exist", line, (long long)index);
+					out_error = error;
+					return false;
+				}
+				uint32_t current = (uint32_t)vertex_index;
+				if (corners == 0)
+					first = current;
+				else if (corners >= 2) {
+					out_vertex_indices.push_back(first);
+					out_vertex_indices.push_back(previous);
+					out_vertex_indices.push_back(current);
+				}
+				previous = current;
+				corners++;
+			}
+			if (corners < 3) {
+				snprintf(error, sizeof(error), "line %d: a face needs at least 3 corners", line);
+				out_error = error;
+				return false;
+			}
+		}
+		// Anything else is a comment, texture coordinate, normal, group or material, none of them are used
+		p = eol + 1;
+	}
+	return true;
+}
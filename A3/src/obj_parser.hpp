@@ -0,0 +1,18 @@
+#pragma once
+
+// stlib
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// internal
+#include "components.hpp"
+
+// Parses the text of an OBJ file, e.g. a MappedFile, without copying it. Reads the vertex positions with
+// their optional colors ("v x y z [r g b]", white without) and the faces in all index forms ("f v",
+// "v/vt", "v//vn" and "v/vt/vn", negative indices count back from the last vertex). Polygons are split
+// into triangle fans, texture coordinates and normals are skipped as the meshes don't use them.
+// The outputs are reserved from a first pass that only counts lines, so they never grow while parsing.
+// On a malformed line out_error says where and false is returned.
+bool parseOBJ(const char* text, size_t length, std::vector<ColoredVertex>& out_vertices, std::vector<uint32_t>& out_vertex_indices, std::string& out_error);
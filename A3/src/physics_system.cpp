@@ -1,7 +1,14 @@
 // internal
 #include "physics_system.hpp"
+#include "game_config.hpp"
+#include "profiler.hpp"
+#include "thread_pool.hpp"
 #include "world_init.hpp"
 
+// Work per job of the parallel loops
+const size_t BODIES_PER_JOB = 256;
+const size_t PAIR_ROWS_PER_JOB = 32;
+
 RenderSystem* renderer;
 float window_width_px;
 float window_height_px;
@@ -64,7 +71,7 @@ void impulse_collision_resolution(Motion& motion1, Motion& motion2, Physics& phy
 void prevent_collision_overlap(Entity entity, Entity other) {
 	Motion& motion1 = registry.motions.get(entity);
 	Motion& motion2 = registry.motions.get(other);
-	const float pen_scaling_factor = 10;
+	const float pen_scaling_factor = game_config.penetration_scaling;
 	vec2 box1 = get_bounding_box(motion1);
 	vec2 box2 = get_bounding_box(motion2);
 	float x2_bound = motion2.position[0] - box2[0] / 2.f;
@@ -104,13 +111,13 @@ void prevent_pebble_wall_penetration(Entity entity, int window_height_px) {
 	float y_penetration = motion.position.y + physics.radius - window_height_px;
 	if (y_penetration > 0) {
 		motion.position.y = motion.position.y - y_penetration;
-		motion.velocity.y = -motion.velocity.y * 0.3;
+		motion.velocity.y = -motion.velocity.y * game_config.pebble_floor_restitution;
 	}
 }
 
-float add_drag_to_acceleration(const Motion& motion, float area = 0.03235840433, float mass = 8) { // Assume salmon has radius 3" and mass of 8kg
-	const float dragCoefficient = 0.4;
-	const float density = 1000; // density of water is 1000 kg/m^2
+float add_drag_to_acceleration(const Motion& motion, float area = game_config.salmon_drag_area, float mass = game_config.salmon_mass) { // Assume salmon has radius 3" and mass of 8kg
+	const float dragCoefficient = game_config.drag_coefficient;
+	const float density = game_config.water_density; // density of water is 1000 kg/m^2
 	float velocity = sqrtf(motion.velocity[0] * motion.velocity[0] / 250 + motion.velocity[1] * motion.velocity[1] / 250); // scaled as m/s with 50 units = 1m
 	float dragF = 0.5 * density * area * dragCoefficient * velocity * velocity; // force in N
 	return dragF / mass;
@@ -119,9 +126,9 @@ float add_drag_to_acceleration(const Motion& motion, float area = 0.03235840433,
 float add_flowing_water_force_to_acc(const Motion& motion, Physics& physics) { 
 	float area = M_PI * physics.radius * physics.radius;
 	float mass = physics.mass;
-	const float dragCoefficient = 0.5; //sphere
-	const float density = 1000; //water
-	float velocity = 0.3;
+	const float dragCoefficient = game_config.flow_drag_coefficient; //sphere
+	const float density = game_config.water_density; //water
+	float velocity = game_config.water_flow_speed;
 	float dragF = 0.5 * density * area * dragCoefficient * velocity * velocity; // force in N
 	return dragF / mass;
 }
@@ -137,7 +144,7 @@ void step_update_velocity(Motion& motion, float step_seconds) {
 }
 
 void step_update_swimming_acceleration(Motion& motion, float step_seconds) {
-	const float swimming_acceleration = 250;
+	const float swimming_acceleration = game_config.swimming_acceleration;
 	float velVectorLength = sqrt((motion.velocity[0] * motion.velocity[0]) + (motion.velocity[1] * motion.velocity[1]));
 	float dragDecel = add_drag_to_acceleration(motion);
 	motion.acceleration[0] = motion.facing[0] * swimming_acceleration * motion.is_swimming;
@@ -226,18 +233,11 @@ void set_vars(float w, float h, RenderSystem* r) {
 	renderer = r;
 }
 
-void PhysicsSystem::step(float elapsed_ms, float window_width_px, float window_height_px, RenderSystem* renderer)
+// Moves every entity by its velocity, each one only touches its own motion
+void PhysicsSystem::integrate_positions(size_t begin, size_t end)
 {
-	set_vars(window_width_px, window_height_px, renderer);
-	Entity& player_entity = registry.players.entities[0];
-	// Move fish based on how much time has passed, this is to (partially) avoid
-	// having entities move at different speed based on the machine.
-	auto& motion_registry = registry.motions;
-	auto& physics_registry = registry.physics;
-	auto& gravity_registry = registry.gravity;
-	ComponentContainer<Motion>& motion_container = registry.motions;
-	float step_seconds = 1.0f * (elapsed_ms / 1000.f);
-	for (uint i = 0; i < motion_registry.size(); i++)
+	ComponentContainer<Motion>& motion_registry = registry.motions;
+	for (size_t i = begin; i < end; i++)
 	{
 		// !!! DONE A1: update motion.position based on step_seconds and motion.velocity
 		Motion& motion = motion_registry.components[i];
@@ -246,24 +246,37 @@ void PhysicsSystem::step(float elapsed_ms, float window_width_px, float window_h
 		// printf("pos = %f, vel = %f\n", motion.position[0], motion.velocity[0]);
 		// (void)elapsed_ms; // placeholder to silence unused warning until implemented
 	}
-	// Simulate acceleration and drag using advanced controls, only for salmon
+}
+
+// Simulate acceleration and drag using advanced controls, only for salmon
+void PhysicsSystem::integrate_player()
+{
+	Entity& player_entity = registry.players.entities[0];
 	if (debugging.is_advanced_controls && !registry.deathTimers.has(player_entity)) {
 		Motion& motion = registry.motions.get(player_entity);
 		step_update_swimming_acceleration(motion, step_seconds);
 		// printf("motion.acceleration[0]: %f, motion.acceleration[1]: %f\n", motion.acceleration[0], motion.acceleration[1]);
 		// printf("velVectorLength: %f\n", velVectorLength);
 	}
+}
 
-	// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
-	// TODO A3: HANDLE PEBBLE UPDATES HERE
-	// DON'T WORRY ABOUT THIS UNTIL ASSIGNMENT 3
-	// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
-	for (uint i = 0; i < motion_container.components.size(); i++)
+// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
+// TODO A3: HANDLE PEBBLE UPDATES HERE
+// DON'T WORRY ABOUT THIS UNTIL ASSIGNMENT 3
+// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
+// Every pebble only reads its own Physics and writes its own Motion and FeelsGravity
+void PhysicsSystem::integrate_gravity(size_t begin, size_t end)
+{
+	ComponentContainer<Motion>& motion_container = registry.motions;
+	auto& physics_registry = registry.physics;
+	auto& gravity_registry = registry.gravity;
+	// Only bodies feel gravity, [begin, end) is within registry.bodies
+	for (size_t i = begin; i < end; i++)
 	{
 		Entity entity = motion_container.entities[i];
 		if (!gravity_registry.has(entity))
 			continue;
-		Physics& physics = physics_registry.get(entity);
+		Physics& physics = physics_registry.components[i];
 		Motion& motion = motion_container.components[i];
 		FeelsGravity& gravity = gravity_registry.get(entity);
 		if (gravity_registry.has(entity)) {
@@ -274,13 +287,13 @@ void PhysicsSystem::step(float elapsed_ms, float window_width_px, float window_h
 				gravity.is_free_fall = true;
 			}
 			if (gravity.is_free_fall || !debugging.is_advance_physics) {
-				motion.acceleration.y = 9.8 * 50; // ~1/10 of normal gravity or rocks sink really
+				motion.acceleration.y = game_config.pebble_gravity; // ~1/10 of normal gravity or rocks sink really
 			}
 			else {
 				motion.acceleration.y = 0;
 			}
 			if (debugging.is_advance_physics) {
-				float water_drag_force = add_drag_to_acceleration(motion, M_PI * pow((motion.scale.x / 100), 2), physics_registry.get(entity).mass);
+				float water_drag_force = add_drag_to_acceleration(motion, M_PI * pow((motion.scale.x / 100), 2), physics.mass);
 				float flowing_water_force = add_flowing_water_force_to_acc(motion, physics);
 				float velVectorLength = sqrt((motion.velocity[0] * motion.velocity[0]) + (motion.velocity[1] * motion.velocity[1]));
 				motion.acceleration[0] = -1 * water_drag_force * motion.velocity[0] / velVectorLength - flowing_water_force;
@@ -290,12 +303,18 @@ void PhysicsSystem::step(float elapsed_ms, float window_width_px, float window_h
 			step_update_velocity(motion, step_seconds);
 		}
 	}
+}
 
-	// Check for collisions between all moving entities
-	for (uint i = 0; i < motion_container.components.size(); i++)
+// Tests rows [begin, end) of the pair matrix, the pairs go into the buffer of the chunk so that
+// concatenating the buffers in order gives the same events as a serial loop
+void PhysicsSystem::find_colliding_pairs(size_t begin, size_t end)
+{
+	ComponentContainer<Motion>& motion_container = registry.motions;
+	std::vector<std::pair<uint, uint>>& pairs = chunk_pairs[begin / PAIR_ROWS_PER_JOB];
+	pairs.clear();
+	for (uint i = (uint)begin; i < end; i++)
 	{
 		Motion& motion_i = motion_container.components[i];
-		Entity entity_i = motion_container.entities[i];
 		for (uint j = 0; j < motion_container.components.size(); j++) // i+1
 		{
 			if (i == j)
@@ -303,15 +322,66 @@ void PhysicsSystem::step(float elapsed_ms, float window_width_px, float window_h
 
 			Motion& motion_j = motion_container.components[j];
 			if (collides(motion_i, motion_j))
-			{
-				Entity entity_j = motion_container.entities[j];
-				// Create a collisions event
-				// We are abusing the ECS system a bit in that we potentially insert muliple collisions for the same entity
-				registry.collisions.emplace_with_duplicates(entity_i, entity_j);
-				registry.collisions.emplace_with_duplicates(entity_j, entity_i);
-			}
+				pairs.emplace_back(i, j);
 		}
 	}
+}
+
+void PhysicsSystem::step(float elapsed_ms, float window_width_px, float window_height_px, RenderSystem* renderer)
+{
+	set_vars(window_width_px, window_height_px, renderer);
+	Entity& player_entity = registry.players.entities[0];
+	// Move fish based on how much time has passed, this is to (partially) avoid
+	// having entities move at different speed based on the machine.
+	ComponentContainer<Motion>& motion_container = registry.motions;
+	step_seconds = 1.0f * (elapsed_ms / 1000.f);
+
+	// The jobs of a step: positions first, then the player, gravity and finally the collision tests,
+	// which need the positions after the pebbles were pushed out of the floor.
+	// The graph is built once, the jobs read the step parameters from the members.
+	if (step_graph.size() == 0) {
+		JobGraph::JobId positions = step_graph.add([this]() {
+			PROFILE_SCOPE("physics.integrate");
+			thread_pool.parallel_for(registry.motions.size(), BODIES_PER_JOB, [this](size_t begin, size_t end) {
+				integrate_positions(begin, end);
+			});
+		});
+		JobGraph::JobId player = step_graph.add([this]() {
+			integrate_player();
+		});
+		JobGraph::JobId gravity = step_graph.add([this]() {
+			PROFILE_SCOPE("physics.gravity");
+			thread_pool.parallel_for(registry.bodies.size(), BODIES_PER_JOB, [this](size_t begin, size_t end) {
+				integrate_gravity(begin, end);
+			});
+		});
+		JobGraph::JobId narrowphase = step_graph.add([this]() {
+			PROFILE_SCOPE("physics.narrowphase");
+			thread_pool.parallel_for(registry.motions.size(), PAIR_ROWS_PER_JOB, [this](size_t begin, size_t end) {
+				find_colliding_pairs(begin, end);
+			});
+		});
+		step_graph.depends_on(player, positions);
+		step_graph.depends_on(gravity, positions);
+		step_graph.depends_on(narrowphase, gravity);
+	}
+	chunk_pairs.resize((motion_container.size() + PAIR_ROWS_PER_JOB - 1) / PAIR_ROWS_PER_JOB);
+	step_graph.run();
+
+	// Check for collisions between all moving entities
+	// The chunks hold the colliding pairs in the order of a serial loop, the ECS only sees the final events
+	ScopedTimer events_timer("physics.collision_events");
+	for (const std::vector<std::pair<uint, uint>>& pairs : chunk_pairs)
+		for (const std::pair<uint, uint>& pair : pairs)
+		{
+			Entity entity_i = motion_container.entities[pair.first];
+			Entity entity_j = motion_container.entities[pair.second];
+			// Create a collisions event
+			// We are abusing the ECS system a bit in that we potentially insert muliple collisions for the same entity
+			registry.collisions.emplace_with_duplicates(entity_i, entity_j);
+			registry.collisions.emplace_with_duplicates(entity_j, entity_i);
+		}
+	events_timer.stop();
 
 	// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
 	// TODO A2: HANDLE SALMON - WALL collisions HERE
@@ -343,6 +413,7 @@ void PhysicsSystem::step(float elapsed_ms, float window_width_px, float window_h
 	// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
 
 	// debugging of bounding boxes
+	PROFILE_SCOPE("physics.debug_draw");
 	uint size_before_adding_new = (uint)motion_container.components.size();
 	for (uint i = 0; i < size_before_adding_new; i++)
 	{
@@ -353,10 +424,10 @@ void PhysicsSystem::step(float elapsed_ms, float window_width_px, float window_h
 		if (entity_i != player_entity) {
 			if (debugging.in_debug_mode)
 			{
-				Entity lineLeft = createLine(motion_i.position - vec2({ bonding_box.x / 2, 0 }), vec2({ motion_i.scale.x / 30, bonding_box.y }));
-				Entity lineRight = createLine(motion_i.position + vec2({ bonding_box.x / 2, 0 }), vec2({ motion_i.scale.x / 30, bonding_box.y }));
-				Entity lineTop = createLine(motion_i.position - vec2({ 0, bonding_box.y / 2 }), vec2({ bonding_box.x, motion_i.scale.x / 30 }));
-				Entity lineBot = createLine(motion_i.position + vec2({ 0, bonding_box.y / 2 }), vec2({ bonding_box.x, motion_i.scale.x / 30 }));
+				drawDebugLine(motion_i.position - vec2({ bonding_box.x / 2, 0 }), vec2({ motion_i.scale.x / 30, bonding_box.y }));
+				drawDebugLine(motion_i.position + vec2({ bonding_box.x / 2, 0 }), vec2({ motion_i.scale.x / 30, bonding_box.y }));
+				drawDebugLine(motion_i.position - vec2({ 0, bonding_box.y / 2 }), vec2({ bonding_box.x, motion_i.scale.x / 30 }));
+				drawDebugLine(motion_i.position + vec2({ 0, bonding_box.y / 2 }), vec2({ bonding_box.x, motion_i.scale.x / 30 }));
 			}
 		}
 		else {
@@ -374,7 +445,7 @@ void PhysicsSystem::step(float elapsed_ms, float window_width_px, float window_h
 					float vertex_y = transformed_vertex.y;
 					if (debugging.in_debug_mode)
 					{
-						Entity vertex = createLine(vec2({ ((vertex_x + 1) / 2.f) * window_width_px, (1 - ((vertex_y + 1) / 2.f)) * window_height_px }),
+						drawDebugLine(vec2({ ((vertex_x + 1) / 2.f) * window_width_px, (1 - ((vertex_y + 1) / 2.f)) * window_height_px }),
 							vec2({ motion_i.scale.x / 25, motion_i.scale.x / 25 }));
 					}
 					if (vertex_x < left_vertex_bound) {
@@ -398,10 +469,10 @@ void PhysicsSystem::step(float elapsed_ms, float window_width_px, float window_h
 				bounding_box = { bounding_box_width, bounding_box_height };
 				if (debugging.in_debug_mode)
 				{
-					Entity lineLeft = createLine(center - vec2({ bounding_box.x / 2.f, 0 }), { motion_i.scale.x / 30, bounding_box.y });
-					Entity lineRight = createLine(center + vec2({ bounding_box.x / 2.f, 0 }), { motion_i.scale.x / 30, bounding_box.y });
-					Entity lineTop = createLine(center - vec2({ 0, bounding_box.y / 2 }), { bounding_box.x, motion_i.scale.x / 30 });
-					Entity lineBot = createLine(center + vec2({ 0, bounding_box.y / 2 }), { bounding_box.x, motion_i.scale.x / 30 });
+					drawDebugLine(center - vec2({ bounding_box.x / 2.f, 0 }), { motion_i.scale.x / 30, bounding_box.y });
+					drawDebugLine(center + vec2({ bounding_box.x / 2.f, 0 }), { motion_i.scale.x / 30, bounding_box.y });
+					drawDebugLine(center - vec2({ 0, bounding_box.y / 2 }), { bounding_box.x, motion_i.scale.x / 30 });
+					drawDebugLine(center + vec2({ 0, bounding_box.y / 2 }), { bounding_box.x, motion_i.scale.x / 30 });
 				}
 			}
 		}
@@ -417,20 +488,24 @@ void PhysicsSystem::step(float elapsed_ms, float window_width_px, float window_h
 	// TODO A3: HANDLE PEBBLE collisions HERE
 	// DON'T WORRY ABOUT THIS UNTIL ASSIGNMENT 3
 	// !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
-	for (uint i = 0; i < motion_container.components.size(); i++)
+	// Resolving a contact moves both pebbles, so this stays on the main thread
+	PROFILE_SCOPE("physics.pebble_contacts");
+	auto& physics_registry = registry.physics;
+	auto& gravity_registry = registry.gravity;
+	// The entities with a motion and physics are the first bodies.size() of both containers, in the same order
+	uint bodies = registry.bodies.size();
+	for (uint i = 0; i < bodies; i++)
 	{
 		Motion& motion_i = motion_container.components[i];
+		Physics& physics_i = physics_registry.components[i];
 		Entity entity_i = motion_container.entities[i];
-		if (!physics_registry.has(entity_i))
-			continue;
-		for (uint j = 0; j < motion_container.components.size(); j++) // i+1
+		for (uint j = 0; j < bodies; j++) // i+1
 		{
-			Entity entity_j = motion_container.entities[j];
-			if (i == j || !physics_registry.has(entity_j))
+			if (i == j)
 				continue;
-			Physics& physics_i = physics_registry.get(entity_i);
-			Physics& physics_j = physics_registry.get(entity_j);
 			Motion& motion_j = motion_container.components[j];
+			Physics& physics_j = physics_registry.components[j];
+			Entity entity_j = motion_container.entities[j];
 			if (collides_spheres(motion_i, motion_j, physics_i, physics_j))
 			{
 				if (gravity_registry.has(entity_i)) {
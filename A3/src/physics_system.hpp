@@ -5,6 +5,7 @@
 #include "components.hpp"
 #include "tiny_ecs_registry.hpp"
 #include "render_system.hpp"
+#include "thread_pool.hpp"
 
 vec2 get_bounding_box(const Motion& motion);
 
@@ -17,6 +18,7 @@ void step_handle_player_wall_collision(Motion& motion, float step_seconds);
 void step_handle_player_wall_bb_collision(Motion& motion, float step_seconds, vec2& bounding_box);
 
 // A simple physics system that moves rigid bodies and checks for collision
+// The integration and the collision tests run as jobs on the thread pool.
 class PhysicsSystem
 {
 public:
@@ -25,4 +27,15 @@ public:
 	PhysicsSystem()
 	{
 	}
+
+private:
+	void integrate_positions(size_t begin, size_t end);
+	void integrate_player();
+	void integrate_gravity(size_t begin, size_t end);
+	void find_colliding_pairs(size_t begin, size_t end);
+
+	float step_seconds = 0;
+	JobGraph step_graph;
+	// Colliding index pairs found by each chunk of the collision tests, kept to re-use their memory
+	std::vector<std::vector<std::pair<uint, uint>>> chunk_pairs;
 };
\ No newline at end of file
@@ -0,0 +1,235 @@
+// internal
+#include "profiler.hpp"
+
+// stlib
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+
+const size_t Profiler::RING_CAPACITY;
+const size_t Profiler::HISTORY_FRAMES;
+const size_t Profiler::MAX_RECORDED_EVENTS;
+
+Profiler profiler;
+
+// Small per-thread ids for the trace, in the order threads first record a scope
+static unsigned int profiler_thread_id()
+{
+	static std::atomic<unsigned int> next_id{ 0 };
+	thread_local unsigned int id = next_id++;
+	return id;
+}
+
+void ScopedTimer::stop()
+{
+	if (!active)
+		return;
+	active = false;
+	Profiler::Event event;
+	event.name = name;
+	event.start_us = start_us;
+	event.duration_us = profiler.now_us() - start_us;
+	event.frame = profiler.frame();
+	event.thread = profiler_thread_id();
+	AllocationCounts allocations = thread_allocations();
+	event.allocations = allocations.allocations - start_allocations.allocations;
+	event.allocated_bytes = allocations.bytes - start_allocations.bytes;
+	profiler.push(event);
+}
+
+Profiler::Profiler()
+	: start_time(std::chrono::steady_clock::now())
+	, ring(RING_CAPACITY)
+{
+	profiler_thread_id(); // the thread that starts the program is thread 0
+	allow_allocations();
+}
+
+void Profiler::allow_allocations()
+{
+	check_allocations_from_frame = frame() + allocation_warmup_frames;
+}
+
+uint64_t Profiler::now_us() const
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time).count();
+}
+
+void Profiler::push(const Event& event)
+{
+	// Claim the next slot, unless it still holds an event the main thread has not read
+	uint64_t index = write_index.load(std::memory_order_relaxed);
+	do {
+		if (index - read_index.load(std::memory_order_acquire) >= RING_CAPACITY) {
+			dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+	} while (!write_index.compare_exchange_weak(index, index + 1, std::memory_order_relaxed));
+
+	Slot& slot = ring[index & (RING_CAPACITY - 1)];
+	slot.event = event;
+	slot.sequence.store(index + 1, std::memory_order_release);
+}
+
+void Profiler::add_to_history(const char* name, float ms, uint64_t allocations, uint64_t bytes)
+{
+	History& history = histories[name];
+	if (history.frame_ms.empty())
+		history.frame_ms.assign(HISTORY_FRAMES, 0.f);
+	history.this_frame_ms += ms;
+	history.this_frame_allocations += allocations;
+	history.this_frame_bytes += bytes;
+}
+
+// Goes through the ring, the histories are only touched by the main thread in end_frame
+void Profiler::add_sample(const char* name, float ms)
+{
+	if (!enabled)
+		return;
+	Event event;
+	event.name = name;
+	uint64_t end_us = now_us();
+	event.duration_us = std::min((uint64_t)(ms * 1000.f + 0.5f), end_us);
+	event.start_us = end_us - event.duration_us;
+	event.frame = frame();
+	event.thread = profiler_thread_id();
+	event.is_sample = true;
+	push(event);
+}
+
+void Profiler::add_counter(const char* name, double value)
+{
+	if (!enabled)
+		return;
+	Event event;
+	event.name = name;
+	event.start_us = now_us();
+	event.frame = frame();
+	event.thread = profiler_thread_id();
+	event.is_counter = true;
+	event.value = value;
+	push(event);
+}
+
+void Profiler::end_frame()
+{
+	AllocationCounts allocations = total_allocations();
+	last_frame_allocations.allocations = allocations.allocations - frame_start_allocations.allocations;
+	last_frame_allocations.bytes = allocations.bytes - frame_start_allocations.bytes;
+	last_frame_allocations.frees = allocations.frees - frame_start_allocations.frees;
+
+	// Drain everything that is fully written, a slot that is still being filled is picked up next frame
+	uint64_t read = read_index.load(std::memory_order_relaxed);
+	uint64_t written = write_index.load(std::memory_order_acquire);
+	for (; read < written; read++) {
+		Slot& slot = ring[read & (RING_CAPACITY - 1)];
+		if (slot.sequence.load(std::memory_order_acquire) != read + 1)
+			break;
+		const Event& event = slot.event;
+		if (!event.is_counter)
+			add_to_history(event.name, event.duration_us / 1000.f, event.allocations, event.allocated_bytes);
+		if (recorded.size() >= MAX_RECORDED_EVENTS) // keep the most recent half
+			recorded.erase(recorded.begin(), recorded.begin() + MAX_RECORDED_EVENTS / 2);
+		recorded.push_back(event);
+		read_index.store(read + 1, std::memory_order_release);
+	}
+
+	// Every known scope gets an entry per frame, frames it did not run in count as 0
+	std::vector<float> sorted;
+	sorted.reserve(HISTORY_FRAMES);
+	for (auto& entry : histories) {
+		History& history = entry.second;
+		history.frame_ms[history.next] = history.this_frame_ms;
+		history.next = (history.next + 1) % HISTORY_FRAMES;
+		history.frames = std::min(history.frames + 1, HISTORY_FRAMES);
+		history.stats.last_ms = history.this_frame_ms;
+		history.stats.allocations = history.this_frame_allocations;
+		history.stats.allocated_bytes = history.this_frame_bytes;
+		history.this_frame_ms = 0;
+		history.this_frame_allocations = 0;
+		history.this_frame_bytes = 0;
+
+		// While filling up, the valid entries are the first 'frames' ones
+		size_t frames = history.frames;
+		sorted.assign(history.frame_ms.begin(), history.frame_ms.begin() + frames);
+		std::sort(sorted.begin(), sorted.end());
+		history.stats.p50_ms = sorted[(frames - 1) / 2];
+		history.stats.p99_ms = sorted[(frames - 1) * 99 / 100];
+	}
+
+	if (assert_no_allocations && frame() >= check_allocations_from_frame && last_frame_allocations.allocations > 0) {
+		report_frame_allocations();
+		abort();
+	}
+	current_frame.fetch_add(1, std::memory_order_relaxed);
+
+	// Started last, so that the bookkeeping above is not charged to the next frame
+	frame_start_allocations = total_allocations();
+}
+
+void Profiler::report_frame_allocations() const
+{
+	fprintf(stderr, "Frame %u made %d heap allocations (%d bytes) in steady state, by scope:\n",
+		frame(), (int)last_frame_allocations.allocations, (int)last_frame_allocations.bytes);
+	for (const auto& entry : histories)
+		if (entry.second.stats.allocations > 0)
+			fprintf(stderr, "%8d allocations %10d bytes  %s\n", (int)entry.second.stats.allocations, (int)entry.second.stats.allocated_bytes, entry.first);
+}
+
+Profiler::ScopeStats Profiler::stats(const char* name) const
+{
+	auto it = histories.find(name);
+	return it == histories.end() ? ScopeStats() : it->second.stats;
+}
+
+void Profiler::write_overlay(char* buffer, size_t size) const
+{
+	int written = snprintf(buffer, size, "p50/p99 ms:");
+	for (const auto& entry : histories) {
+		if (strchr(entry.first, '.') != nullptr || written < 0 || (size_t)written >= size)
+			continue;
+		written += snprintf(buffer + written, size - written, " %s %.2f/%.2f", entry.first, entry.second.stats.p50_ms, entry.second.stats.p99_ms);
+	}
+	if (written >= 0 && (size_t)written < size)
+		snprintf(buffer + written, size - written, " | %d allocs/frame", (int)last_frame_allocations.allocations);
+}
+
+bool Profiler::write_csv(const std::string& path) const
+{
+	std::ofstream file(path);
+	if (!file)
+		return false;
+	file << "frame,thread,name,start_us,duration_us,allocations,allocated_bytes,value\n";
+	for (const Event& event : recorded) {
+		file << event.frame << "," << event.thread << "," << event.name << "," << event.start_us << "," << event.duration_us << ","
+			<< event.allocations << "," << event.allocated_bytes << ",";
+		if (event.is_counter)
+			file << event.value;
+		file << "\n";
+	}
+	return true;
+}
+
+// The format is described in "Trace Event Format" and loads in chrome://tracing or ui.perfetto.dev
+bool Profiler::write_chrome_trace(const std::string& path) const
+{
+	std::ofstream file(path);
+	if (!file)
+		return false;
+	file << "{\"traceEvents\":[\n";
+	for (size_t i = 0; i < recorded.size(); i++) {
+		const Event& event = recorded[i];
+		if (event.is_counter)
+			file << "{\"name\":\"" << event.name << "\",\"cat\":\"counter\",\"ph\":\"C\",\"ts\":" << event.start_us
+				<< ",\"pid\":0,\"tid\":" << event.thread << ",\"args\":{\"value\":" << event.value << "}}";
+		else
+			file << "{\"name\":\"" << event.name << "\",\"cat\":\"" << (event.is_sample ? "sample" : "cpu") << "\",\"ph\":\"X\",\"ts\":" << event.start_us
+				<< ",\"dur\":" << event.duration_us << ",\"pid\":0,\"tid\":" << event.thread
+				<< ",\"args\":{\"frame\":" << event.frame << ",\"allocations\":" << event.allocations
+				<< ",\"allocated_bytes\":" << event.allocated_bytes << "}}";
+		file << (i + 1 < recorded.size() ? ",\n" : "\n");
+	}
+	file << "],\"displayTimeUnit\":\"ms\"}\n";
+	return true;
+}
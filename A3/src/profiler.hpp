@@ -0,0 +1,164 @@
+#pragma once
+
+// stlib
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <string.h>
+
+// internal
+#include "alloc_tracker.hpp"
+
+// Collects the time spent in named scopes on any thread. ScopedTimer pushes an event into a
+// lock-free ring buffer, the main thread drains it once per frame in end_frame() to update the
+// rolling per-scope statistics and the recorded trace, which can be saved as CSV or Chrome trace JSON.
+class Profiler
+{
+public:
+	// One timed scope or counter sample, times are in microseconds since the profiler started
+	struct Event {
+		const char* name = nullptr; // must be a string literal, only the pointer is stored
+		uint64_t start_us = 0;
+		uint64_t duration_us = 0;
+		unsigned int frame = 0;
+		unsigned int thread = 0;
+		uint64_t allocations = 0; // heap allocations made in the scope by its thread
+		uint64_t allocated_bytes = 0;
+		bool is_counter = false;
+		bool is_sample = false; // measured elsewhere, see add_sample
+		double value = 0; // counters only
+	};
+
+	// Rolling statistics of one scope over the last HISTORY_FRAMES frames, in milliseconds per frame
+	struct ScopeStats {
+		float last_ms = 0;
+		float p50_ms = 0;
+		float p99_ms = 0;
+		uint64_t allocations = 0; // in the last frame
+		uint64_t allocated_bytes = 0;
+	};
+
+	static const size_t RING_CAPACITY = 1 << 16; // power of two
+	static const size_t HISTORY_FRAMES = 240;
+	static const size_t MAX_RECORDED_EVENTS = 1 << 18;
+
+	Profiler();
+
+	// Whether scopes are timed at all
+	bool enabled = true;
+	// Whether the window title shows the rolling p50/p99 of each scope
+	bool show_overlay = false;
+	// Abort with a report of the allocating scopes when a steady state frame allocates
+	bool assert_no_allocations = false;
+	// Frames that may allocate after start-up or allow_allocations(), e.g. to fill pools and reserve vectors
+	unsigned int allocation_warmup_frames = 120;
+
+	uint64_t now_us() const;
+
+	// Thread safe and lock free, drops the event if the main thread fell a full ring behind
+	void push(const Event& event);
+
+	// Folds the events of the frame into the statistics and the recorded trace, call on the main thread
+	void end_frame();
+
+	// Starts a new warm up period for assert_no_allocations, call after loading or restarting
+	void allow_allocations();
+
+	// Allocations made by all threads during the last frame, not counting the profiler's own bookkeeping
+	const AllocationCounts& frame_allocations() const { return last_frame_allocations; }
+
+	// Adds a time that was measured elsewhere (e.g. on the GPU) to the statistics, thread safe like push.
+	// It counts towards the frame that drains it, the trace shows it as ending now.
+	void add_sample(const char* name, float ms);
+
+	// Records the current value of a counter (e.g. memory in use), it shows up as a graph in the trace
+	void add_counter(const char* name, double value);
+
+	unsigned int frame() const { return current_frame.load(std::memory_order_relaxed); }
+	size_t dropped_events() const { return dropped.load(std::memory_order_relaxed); }
+
+	// Statistics of a scope, all zero if it never ran
+	ScopeStats stats(const char* name) const;
+
+	// Forgets the statistics of all scopes, e.g. between two runs of a benchmark
+	void clear_stats() { histories.clear(); }
+
+	// "name p50/p99" of every top-level scope and the allocations of the last frame, for the window title.
+	// Writes into a fixed buffer so that showing it every frame doesn't allocate.
+	void write_overlay(char* buffer, size_t size) const;
+
+	// Write the recorded events, returns false if the file could not be opened
+	bool write_csv(const std::string& path) const;
+	bool write_chrome_trace(const std::string& path) const;
+
+private:
+	struct Slot {
+		std::atomic<uint64_t> sequence{ 0 }; // index + 1 of the event in this slot once it is written
+		Event event;
+	};
+
+	struct History {
+		std::vector<float> frame_ms; // circular, HISTORY_FRAMES entries
+		size_t next = 0;
+		size_t frames = 0; // valid entries, less than HISTORY_FRAMES while filling up
+		float this_frame_ms = 0;
+		uint64_t this_frame_allocations = 0;
+		uint64_t this_frame_bytes = 0;
+		ScopeStats stats;
+	};
+
+	// Orders names by their text, the same literal may have a different address in every translation unit
+	struct NameLess {
+		bool operator()(const char* a, const char* b) const { return strcmp(a, b) < 0; }
+	};
+
+	void add_to_history(const char* name, float ms, uint64_t allocations = 0, uint64_t bytes = 0);
+	void report_frame_allocations() const;
+
+	std::chrono::steady_clock::time_point start_time;
+	std::vector<Slot> ring;
+	std::atomic<uint64_t> write_index{ 0 };
+	std::atomic<uint64_t> read_index{ 0 };
+	std::atomic<size_t> dropped{ 0 };
+	std::atomic<unsigned int> current_frame{ 0 };
+
+	std::map<const char*, History, NameLess> histories; // ordered, so the overlay is stable
+	std::vector<Event> recorded;
+
+	AllocationCounts frame_start_allocations;
+	AllocationCounts last_frame_allocations;
+	unsigned int check_allocations_from_frame = 0;
+};
+
+extern Profiler profiler;
+
+// Times the enclosing block (or until stop()), see PROFILE_SCOPE
+class ScopedTimer
+{
+public:
+	explicit ScopedTimer(const char* name)
+		: name(name)
+		, start_us(profiler.enabled ? profiler.now_us() : 0)
+		, start_allocations(thread_allocations())
+		, active(profiler.enabled) {}
+	~ScopedTimer() { stop(); }
+	ScopedTimer(const ScopedTimer&) = delete;
+	ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+	// Ends the scope early, for consecutive phases of one function
+	void stop();
+
+private:
+	const char* name;
+	uint64_t start_us;
+	AllocationCounts start_allocations;
+	bool active;
+};
+
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+// Names use dots for nesting, e.g. "physics.broadphase" is shown under "physics"
+#define PROFILE_SCOPE(name) ScopedTimer PROFILE_CONCAT(profile_scope_, __LINE__)(name)
@@ -0,0 +1,128 @@
+// internal
+#include "program_cache.hpp"
+
+// stlib
+#include <stdio.h>
+#include <string.h>
+
+// Layout of a program cache file: this header and length bytes of the binary
+struct ProgramCacheHeader
+{
+	char magic[4]; // "PRGB"
+	uint32_t version;
+	uint64_t key;
+	uint32_t format;
+	uint32_t length;
+};
+
+const uint32_t PROGRAM_CACHE_VERSION = 1;
+
+bool programBinariesSupported()
+{
+	if (glGetProgramBinary == nullptr || glProgramBinary == nullptr || glProgramParameteri == nullptr)
+		return false;
+	GLint formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	return formats > 0;
+}
+
+std::string glDriverDescription()
+{
+	std::string description;
+	for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION }) {
+		const GLubyte* value = glGetString(name);
+		description += value ? (const char*)value : "";
+		description += '\n';
+	}
+	return description;
+}
+
+// FNV-1a
+static void hash_bytes(uint64_t& hash, const std::string& bytes)
+{
+	for (char c : bytes) {
+		hash ^= (uint8_t)c;
+		hash *= 1099511628211ull;
+	}
+	// Keeps "ab" + "c" apart from "a" + "bc"
+	hash ^= bytes.size();
+	hash *= 1099511628211ull;
+}
+
+uint64_t programCacheKey(const std::string& vs_str, const std::string& fs_str, const std::string& driver)
+{
+	uint64_t hash = 14695981039346656037ull;
+	hash_bytes(hash, vs_str);
+	hash_bytes(hash, fs_str);
+	hash_bytes(hash, driver);
+	return hash;
+}
+
+bool readProgramBinary(const std::string& cache_path, uint64_t key, ProgramBinary& out_binary)
+{
+	FILE* file = fopen(cache_path.c_str(), "rb");
+	if (file == NULL)
+		return false;
+	ProgramCacheHeader header;
+	bool is_read = fread(&header, sizeof(header), 1, file) == 1 && memcmp(header.magic, "PRGB", 4) == 0 &&
+		header.version == PROGRAM_CACHE_VERSION && header.key == key && header.length > 0;
+	if (is_read) {
+		out_binary.key = key;
+		out_binary.format = header.format;
+		out_binary.data.resize(header.length);
+		is_read = fread(out_binary.data.data(), 1, header.length, file) == header.length;
+	}
+	fclose(file);
+	return is_read;
+}
+
+bool loadProgramBinary(const ProgramBinary& binary, GLuint& out_program)
+{
+	GLuint program = glCreateProgram();
+	glProgramBinary(program, binary.format, binary.data.data(), (GLsizei)binary.data.size());
+	// A rejected binary is a GL_INVALID_ENUM or a failed link, neither is an error of ours
+	while (glGetError() != GL_NO_ERROR)
+		;
+	GLint is_linked = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &is_linked);
+	if (is_linked == GL_FALSE) {
+		glDeleteProgram(program);
+		return false;
+	}
+	out_program = program;
+	return true;
+}
+
+void writeProgramBinary(const std::string& cache_path, uint64_t key, GLuint program)
+{
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+
+	ProgramCacheHeader header;
+	memcpy(header.magic, "PRGB", 4);
+	header.version = PROGRAM_CACHE_VERSION;
+	header.key = key;
+	std::vector<char> data(length);
+	GLenum format = 0;
+	glGetProgramBinary(program, length, &length, &format, data.data());
+	gl_has_errors();
+	header.format = format;
+	header.length = (uint32_t)length;
+
+	// Written next to it and renamed, a crash never leaves half a binary behind
+	std::string temp_path = cache_path + ".tmp";
+	FILE* file = fopen(temp_path.c_str(), "wb");
+	if (file == NULL) {
+		fprintf(stderr, "Could not write the program cache %s\n", cache_path.c_str());
+		return;
+	}
+	bool written = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(data.data(), 1, length, file) == (size_t)length;
+	written = fclose(file) == 0 && written;
+	remove(cache_path.c_str()); // rename doesn't replace files on Windows
+	if (!written || rename(temp_path.c_str(), cache_path.c_str()) != 0) {
+		fprintf(stderr, "Could not write the program cache %s\n", cache_path.c_str());
+		remove(temp_path.c_str());
+	}
+}
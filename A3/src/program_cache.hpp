@@ -0,0 +1,36 @@
+#pragma once
+
+// stlib
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// internal
+#include "common.hpp"
+
+// Linked programs as the driver returns them from glGetProgramBinary, cached on disk next to the shaders
+// (water.program.bin) and keyed by a hash of the shader sources and the driver: a changed shader, GPU or
+// driver version recompiles. The driver may still reject a binary, then the program is compiled as usual.
+struct ProgramBinary
+{
+	uint64_t key = 0;
+	GLenum format = 0;
+	std::vector<char> data;
+};
+
+// GL 4.1 or ARB_get_program_binary, and a driver that has at least one binary format
+bool programBinariesSupported();
+
+// Vendor, renderer and version of the current context's driver
+std::string glDriverDescription();
+
+uint64_t programCacheKey(const std::string& vs_str, const std::string& fs_str, const std::string& driver);
+
+// Reads the cached binary, false if there is none or it is for another key. Doesn't need the GL context
+bool readProgramBinary(const std::string& cache_path, uint64_t key, ProgramBinary& out_binary);
+
+// Creates the program from the binary, false if the driver rejects it
+bool loadProgramBinary(const ProgramBinary& binary, GLuint& out_program);
+
+// The program must have been linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+void writeProgramBinary(const std::string& cache_path, uint64_t key, GLuint program);
@@ -1,27 +1,29 @@
 // internal
 #include "render_system.hpp"
+#include "profiler.hpp"
 #include <SDL.h>
 
+// stlib
+#include <chrono>
+
 #include "tiny_ecs_registry.hpp"
 
-void RenderSystem::drawTexturedMesh(Entity entity,
+void RenderSystem::drawTexturedMesh(const RenderSnapshot::Item &item,
 									const mat3 &projection)
 {
-	Motion &motion = registry.motions.get(entity);
 	// Transformation code, see Rendering and Transformation in the template
 	// specification for more info Incrementally updates transformation matrix,
 	// thus ORDER IS IMPORTANT
 	Transform transform;
-	transform.translate(motion.position);
+	transform.translate(item.position);
 	// !!! DONE A1: add rotation to the chain of transformations, mind the order
 	// of transformations
-	transform.rotate(motion.angle);
-	transform.scale(motion.scale);
+	transform.rotate(item.angle);
+	transform.scale(item.scale);
 
 	
 
-	assert(registry.renderRequests.has(entity));
-	const RenderRequest &render_request = registry.renderRequests.get(entity);
+	const RenderRequest &render_request = item.request;
 
 	const GLuint used_effect_enum = (GLuint)render_request.used_effect;
 	assert(used_effect_enum != (GLuint)EFFECT_ASSET_ID::EFFECT_COUNT);
@@ -62,9 +64,8 @@ void RenderSystem::drawTexturedMesh(Entity entity,
 		glActiveTexture(GL_TEXTURE0);
 		gl_has_errors();
 
-		assert(registry.renderRequests.has(entity));
 		GLuint texture_id =
-			texture_gl_handles[(GLuint)registry.renderRequests.get(entity).used_texture];
+			texture_gl_handles[(GLuint)render_request.used_texture];
 
 		glBindTexture(GL_TEXTURE_2D, texture_id);
 		gl_has_errors();
@@ -90,7 +91,7 @@ void RenderSystem::drawTexturedMesh(Entity entity,
 			// Light up?
 			GLint light_up_uloc = glGetUniformLocation(program, "light_up");
 			assert(light_up_uloc >= 0);
-			glUniform1i(light_up_uloc, registry.lightUpTimers.has(entity));
+			glUniform1i(light_up_uloc, item.light_up);
 
 			// !!! TODO A1: set the light_up shader variable using glUniform1i,
 			// similar to the glUniform1f call below. The 1f or 1i specified the type, here a single int.
@@ -104,16 +105,17 @@ void RenderSystem::drawTexturedMesh(Entity entity,
 
 	// Getting uniform locations for glUniform* calls
 	GLint color_uloc = glGetUniformLocation(program, "fcolor");
-	const vec3 color = registry.colors.has(entity) ? registry.colors.get(entity) : vec3(1);
+	const vec3 color = item.color;
 	glUniform3fv(color_uloc, 1, (float *)&color);
 	gl_has_errors();
 
-	// Get number of indices from index buffer, which has elements uint16_t
+	// Get number of indices from index buffer, which has elements uint16_t or uint32_t
 	GLint size = 0;
 	glGetBufferParameteriv(GL_ELEMENT_ARRAY_BUFFER, GL_BUFFER_SIZE, &size);
 	gl_has_errors();
 
-	GLsizei num_indices = size / sizeof(uint16_t);
+	const GLenum index_type = index_types[(GLuint)render_request.used_geometry];
+	GLsizei num_indices = size / (index_type == GL_UNSIGNED_INT ? sizeof(uint32_t) : sizeof(uint16_t));
 	// GLsizei num_triangles = num_indices / 3;
 
 	GLint currProgram;
@@ -125,21 +127,20 @@ void RenderSystem::drawTexturedMesh(Entity entity,
 	glUniformMatrix3fv(projection_loc, 1, GL_FALSE, (float *)&projection);
 	gl_has_errors();
 	// Drawing of num_indices/3 triangles specified in the index buffer
-	glDrawElements(GL_TRIANGLES, num_indices, GL_UNSIGNED_SHORT, nullptr);
+	glDrawElements(GL_TRIANGLES, num_indices, index_type, nullptr);
 	gl_has_errors();
 }
 
 // draw the intermediate texture to the screen, with some distortion to simulate
 // water
-void RenderSystem::drawToScreen()
+void RenderSystem::drawToScreen(const RenderSnapshot &snapshot)
 {
 	// Setting shaders
 	// get the water texture, sprite mesh, and program
 	glUseProgram(effects[(GLuint)EFFECT_ASSET_ID::WATER]);
 	gl_has_errors();
 	// Clearing backbuffer
-	int w, h;
-	glfwGetFramebufferSize(window, &w, &h);
+	int w = snapshot.framebuffer_size.x, h = snapshot.framebuffer_size.y;
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 	glViewport(0, 0, w, h);
 	glDepthRange(0, 10);
@@ -164,8 +165,7 @@ void RenderSystem::drawToScreen()
 	GLuint time_uloc = glGetUniformLocation(water_program, "time");
 	GLuint dead_timer_uloc = glGetUniformLocation(water_program, "darken_screen_factor");
 	glUniform1f(time_uloc, (float)(glfwGetTime() * 10.0f));
-	ScreenState &screen = registry.screenStates.get(screen_state_entity);
-	glUniform1f(dead_timer_uloc, screen.darken_screen_factor);
+	glUniform1f(dead_timer_uloc, snapshot.darken_screen_factor);
 	gl_has_errors();
 	// Set the vertex position and vertex texture coordinates (both stored in the
 	// same VBO)
@@ -191,9 +191,68 @@ void RenderSystem::drawToScreen()
 // http://www.opengl-tutorial.org/intermediate-tutorials/tutorial-14-render-to-texture/
 void RenderSystem::draw()
 {
-	// Getting size of window
+	capture(frame_snapshot);
+	draw(frame_snapshot);
+}
+
+void RenderSystem::capture(RenderSnapshot &snapshot)
+{
+	PROFILE_SCOPE("render.capture");
 	int w, h;
 	glfwGetFramebufferSize(window, &w, &h);
+	framebuffer_size = { w, h };
+	snapshot.framebuffer_size = framebuffer_size;
+	snapshot.darken_screen_factor = registry.screenStates.get(screen_state_entity).darken_screen_factor;
+
+	// Only entities that have a position and size component are drawn
+	snapshot.items.clear();
+	for (uint i = 0; i < registry.renderRequests.size(); i++)
+	{
+		Entity entity = registry.renderRequests.entities[i];
+		if (!registry.motions.has(entity))
+			continue;
+		const Motion &motion = registry.motions.get(entity);
+		RenderSnapshot::Item item;
+		item.position = motion.position;
+		item.angle = motion.angle;
+		item.scale = motion.scale;
+		item.request = registry.renderRequests.components[i];
+		item.color = registry.colors.has(entity) ? registry.colors.get(entity) : vec3(1);
+		item.light_up = registry.lightUpTimers.has(entity);
+		snapshot.items.push_back(item);
+	}
+}
+
+void RenderSystem::reloadChangedEffects()
+{
+	std::vector<EffectReload> reloads;
+	{
+		std::lock_guard<std::mutex> lock(reload_mutex);
+		reloads.swap(pending_reloads);
+	}
+	for (const EffectReload& reload : reloads)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		GLuint program = 0;
+		if (!loadEffectFromSources(reload.vs_str, reload.fs_str, program))
+		{
+			fprintf(stderr, "%s doesn't compile, it keeps the previous version\n", effect_paths[reload.effect].c_str());
+			continue;
+		}
+		// Nothing draws with the old program any more, draws only happen on this thread
+		glDeleteProgram(effects[reload.effect]);
+		effects[reload.effect] = program;
+		float ms = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		printf("Reloaded %s in %.1f ms\n", effect_paths[reload.effect].c_str(), ms);
+	}
+}
+
+void RenderSystem::draw(const RenderSnapshot &snapshot)
+{
+	reloadChangedEffects();
+
+	// Getting size of window
+	int w = snapshot.framebuffer_size.x, h = snapshot.framebuffer_size.y;
 
 	// First render to the custom framebuffer
 	glBindFramebuffer(GL_FRAMEBUFFER, frame_buffer);
@@ -203,6 +262,8 @@ void RenderSystem::draw()
 	glDepthRange(0.00001, 10);
 	glClearColor(0, 0, 1, 1.0);
 	glClearDepth(1.f);
+	gpu_timer.begin_frame();
+	gpu_timer.begin_section("gpu.scene", "gpu.scene.clear");
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 	glEnable(GL_BLEND);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
@@ -210,36 +271,45 @@ void RenderSystem::draw()
 							  // and alpha blending, one would have to sort
 							  // sprites back to front
 	gl_has_errors();
-	mat3 projection_2D = createProjectionMatrix();
+	mat3 projection_2D = createProjectionMatrix(snapshot.framebuffer_size);
 	// Draw all textured meshes that have a position and size component
-	for (Entity entity : registry.renderRequests.entities)
+	EFFECT_ASSET_ID timed_effect = EFFECT_ASSET_ID::EFFECT_COUNT;
+	for (const RenderSnapshot::Item &item : snapshot.items)
 	{
-		if (!registry.motions.has(entity))
-			continue;
-		// Note, its not very efficient to access elements indirectly via the entity
-		// albeit iterating through all Sprites in sequence. A good point to optimize
-		drawTexturedMesh(entity, projection_2D);
+		// Consecutive draws with the same effect share one GPU timer section
+		EFFECT_ASSET_ID effect = item.request.used_effect;
+		if (effect != timed_effect) {
+			gpu_timer.begin_section("gpu.scene", effect_gpu_scopes[(int)effect]);
+			timed_effect = effect;
+		}
+		drawTexturedMesh(item, projection_2D);
 	}
 
 	// Truely render to the screen
-	drawToScreen();
+	gpu_timer.begin_section("gpu.screen", "gpu.screen.water");
+	drawToScreen(snapshot);
+	gpu_timer.end_frame();
 
-	// flicker-free display with a double buffer
+	// flicker-free display with a double buffer, waits for vsync or the GPU
+	PROFILE_SCOPE("render.swap");
 	glfwSwapBuffers(window);
 	gl_has_errors();
 }
 
 mat3 RenderSystem::createProjectionMatrix()
+{
+	// The size of the last captured frame, GLFW may only be asked on the main thread
+	return createProjectionMatrix(framebuffer_size);
+}
+
+mat3 RenderSystem::createProjectionMatrix(ivec2 size)
 {
 	// Fake projection matrix, scales with respect to window coordinates
 	float left = 0.f;
 	float top = 0.f;
 
-	int w, h;
-	glfwGetFramebufferSize(window, &w, &h);
-	gl_has_errors();
-	float right = (float)w / screen_scale;
-	float bottom = (float)h / screen_scale;
+	float right = (float)size.x / screen_scale;
+	float bottom = (float)size.y / screen_scale;
 
 	float sx = 2.f / (right - left);
 	float sy = 2.f / (top - bottom);
@@ -1,12 +1,35 @@
 #pragma once
 
 #include <array>
+#include <mutex>
 #include <utility>
 
 #include "common.hpp"
 #include "components.hpp"
+#include "file_watcher.hpp"
+#include "gpu_timer.hpp"
+#include "thread_pool.hpp"
 #include "tiny_ecs.hpp"
 
+// Everything a frame draws, copied out of the registry at the end of the simulation step so that
+// it can be drawn while the simulation already works on the next step (see RenderThread).
+// The vectors keep their capacity, so capturing into the same snapshot again doesn't allocate.
+struct RenderSnapshot
+{
+	struct Item
+	{
+		vec2 position;
+		float angle;
+		vec2 scale;
+		RenderRequest request;
+		vec3 color;
+		bool light_up;
+	};
+	std::vector<Item> items; // in the order of the render requests
+	ivec2 framebuffer_size = { 0, 0 };
+	float darken_screen_factor = 0;
+};
+
 // System responsible for setting up OpenGL and for rendering all the
 // visual entities in the game
 class RenderSystem {
@@ -19,6 +42,7 @@ class RenderSystem {
 	 */
 	std::array<GLuint, texture_count> texture_gl_handles;
 	std::array<ivec2, texture_count> texture_dimensions;
+	bool has_bc3_textures = false; // EXT_texture_compression_s3tc, cooked BC3 textures fall back to the PNG without it
 
 	// Make sure these paths remain in sync with the associated enumerators.
 	// Associated id with .obj path
@@ -42,25 +66,36 @@ class RenderSystem {
 		shader_path("textured"),
 		shader_path("water") };
 
+	// GPU profiler scope of the scene draw calls of each effect, they are timed in groups of consecutive draws
+	const std::array<const char*, effect_count> effect_gpu_scopes = {
+		"gpu.scene.coloured",
+		"gpu.scene.pebble",
+		"gpu.scene.salmon",
+		"gpu.scene.textured",
+		"gpu.scene.water" };
+
 	std::array<GLuint, geometry_count> vertex_buffers;
 	std::array<GLuint, geometry_count> index_buffers;
+	std::array<GLenum, geometry_count> index_types; // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT, meshes from files may need 32 bits
 	std::array<Mesh, geometry_count> meshes;
 
 public:
-	// Initialize the window
-	bool init(int width, int height, GLFWwindow* window);
+	// Initialize the window and the GL objects. Loading the textures, shaders and meshes is added to
+	// loads: the files are read and decoded on the workers and uploaded by main thread jobs, the
+	// assets are ready once loads ran
+	bool init(int width, int height, GLFWwindow* window, JobGraph& loads);
 
-	template <class T>
-	void bindVBOandIBO(GEOMETRY_BUFFER_ID gid, std::vector<T> vertices, std::vector<uint16_t> indices);
+	template <class T, class I>
+	void bindVBOandIBO(GEOMETRY_BUFFER_ID gid, const std::vector<T>& vertices, const std::vector<I>& indices);
 
-	void initializeGlTextures();
+	void initializeGlTextures(JobGraph& loads);
 
-	void initializeGlEffects();
+	void initializeGlEffects(JobGraph& loads);
 
-	void initializeGlMeshes();
+	void initializeGlMeshes(JobGraph& loads);
 	Mesh& getMesh(GEOMETRY_BUFFER_ID id) { return meshes[(int)id]; };
 
-	void initializeGlGeometryBuffers();
+	void initializeGlGeometryBuffers(JobGraph& loads);
 	// Initialize the screen texture used as intermediate render target
 	// The draw loop first renders to this texture, then it is used for the water
 	// shader
@@ -72,17 +107,46 @@ public:
 	// Draw all entities
 	void draw();
 
+	// Copies what the next frame draws out of the registry, on the main thread
+	void capture(RenderSnapshot& snapshot);
+	// Draws and presents a captured frame, only uses the snapshot and the GL objects of the system
+	// so it can run on a thread of its own, which then needs the GL context (see RenderThread)
+	void draw(const RenderSnapshot& snapshot);
+
 	mat3 createProjectionMatrix();
 
+	GLFWwindow* getWindow() { return window; }
+
 private:
 	// Internal drawing functions for each entity type
-	void drawTexturedMesh(Entity entity, const mat3& projection);
-	void drawToScreen();
+	void drawTexturedMesh(const RenderSnapshot::Item& item, const mat3& projection);
+	void drawToScreen(const RenderSnapshot& snapshot);
+	mat3 createProjectionMatrix(ivec2 framebuffer_size);
+
+	// Shader hot reload: the watcher thread reads the sources of an edited effect, the thread that draws
+	// compiles them before its next frame and swaps the program, a shader that doesn't compile keeps the old one
+	struct EffectReload
+	{
+		uint effect;
+		std::string vs_str;
+		std::string fs_str;
+	};
+	void watchShaders();
+	void onShaderChanged(const std::string& file_name);
+	void reloadChangedEffects();
+	FileWatcher shader_watcher;
+	std::mutex reload_mutex;
+	std::vector<EffectReload> pending_reloads;
 
 	// Window handle
 	GLFWwindow* window;
 	float screen_scale;  // Screen to pixel coordinates scale factor (for apple
 						 // retina display?)
+	// Only the main thread may ask GLFW, updated by init and capture so that other threads can use it
+	ivec2 framebuffer_size = { 0, 0 };
+
+	// The frame draw() captures and draws right away
+	RenderSnapshot frame_snapshot;
 
 	// Screen texture handles
 	GLuint frame_buffer;
@@ -90,7 +154,16 @@ private:
 	GLuint off_screen_render_buffer_depth;
 
 	Entity screen_state_entity;
+
+	// GPU time of each pass, read back a frame later
+	GpuTimer gpu_timer;
 };
 
 bool loadEffectFromFile(
 	const std::string& vs_path, const std::string& fs_path, GLuint& out_program);
+
+// The two halves of loadEffectFromFile, reading the files doesn't need the GL context
+bool readEffectSources(
+	const std::string& vs_path, const std::string& fs_path, std::string& out_vs, std::string& out_fs);
+bool loadEffectFromSources(
+	const std::string& vs_str, const std::string& fs_str, GLuint& out_program);
@@ -1,8 +1,14 @@
 // internal
+#include "cooked_texture.hpp"
+#include "program_cache.hpp"
 #include "render_system.hpp"
 
+#include <algorithm>
 #include <array>
+#include <cstring>
 #include <fstream>
+#include <memory>
+#include <type_traits>
 
 #include "../ext/stb_image/stb_image.h"
 
@@ -14,7 +20,7 @@
 #include <sstream>
 
 // World initialization
-bool RenderSystem::init(int width, int height, GLFWwindow* window_arg)
+bool RenderSystem::init(int width, int height, GLFWwindow* window_arg, JobGraph& loads)
 {
 	this->window = window_arg;
 
@@ -35,6 +41,7 @@ bool RenderSystem::init(int width, int height, GLFWwindow* window_arg)
 	// https://stackoverflow.com/questions/36672935/why-retina-screen-coordinate-value-is-twice-the-value-of-pixel-value
 	int fb_width, fb_height;
 	glfwGetFramebufferSize(window, &fb_width, &fb_height);
+	framebuffer_size = { fb_width, fb_height };
 	screen_scale = static_cast<float>(fb_width) / width;
 	printf("%f\n", screen_scale);
 	(int)height; // dummy to avoid warning
@@ -52,57 +59,174 @@ bool RenderSystem::init(int width, int height, GLFWwindow* window_arg)
 	gl_has_errors();
 
 	initScreenTexture();
-    initializeGlTextures();
-	initializeGlEffects();
-	initializeGlGeometryBuffers();
+	initializeGlTextures(loads);
+	initializeGlEffects(loads);
+	initializeGlGeometryBuffers(loads);
+	gpu_timer.init();
+	watchShaders();
 
 	return true;
 }
 
-void RenderSystem::initializeGlTextures()
+// What the decode job of a texture hands to its upload job: the mapped cooked texture if there is an
+// up to date one (see tools/texture_cooker.cpp), the pixels of the PNG otherwise
+struct TextureData
+{
+    MappedFile cooked;
+    CookedTextureHeader header;
+    std::vector<CookedTextureLevel> levels;
+    stbi_uc* pixels = nullptr;
+};
+
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+void RenderSystem::initializeGlTextures(JobGraph& loads)
 {
     glGenTextures((GLsizei)texture_gl_handles.size(), texture_gl_handles.data());
 
+    GLint extension_count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extension_count);
+    for (GLint i = 0; i < extension_count; i++)
+        if (strcmp((const char*)glGetStringi(GL_EXTENSIONS, i), "GL_EXT_texture_compression_s3tc") == 0)
+            has_bc3_textures = true;
+
     for(uint i = 0; i < texture_paths.size(); i++)
     {
-        const std::string& path = texture_paths[i];
-        ivec2& dimensions = texture_dimensions[i];
-
-        stbi_uc* data;
-        data  = stbi_load(path.c_str(), &dimensions.x, &dimensions.y, NULL, 4);
-
-        if (data == NULL)
-        {
-			const std::string message = "Could not load the file " + path + ".";
-            fprintf(stderr, "%s", message.c_str());
-            assert(false);
-        }
-        glBindTexture(GL_TEXTURE_2D, texture_gl_handles[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, dimensions.x, dimensions.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		gl_has_errors();
-        stbi_image_free(data);
+        // The file is read on a worker and handed to the upload job
+        std::shared_ptr<TextureData> data = std::make_shared<TextureData>();
+        JobGraph::JobId decode = loads.add([this, i, data]() {
+            const std::string& path = texture_paths[i];
+            ivec2& dimensions = texture_dimensions[i];
+            if (data->cooked.open(cookedTexturePath(path)) && readCookedTexture(data->cooked, path, data->header, data->levels) &&
+                (data->header.format != CookedTextureFormat::BC3 || has_bc3_textures))
+            {
+                dimensions = { (int)data->header.width, (int)data->header.height };
+                return;
+            }
+            data->cooked.close();
+            data->pixels = stbi_load(path.c_str(), &dimensions.x, &dimensions.y, NULL, 4);
+            if (data->pixels == NULL)
+            {
+                const std::string message = "Could not load the file " + path + ".";
+                fprintf(stderr, "%s", message.c_str());
+                assert(false);
+            }
+        });
+        JobGraph::JobId upload = loads.add([this, i, data]() {
+            const ivec2& dimensions = texture_dimensions[i];
+            glBindTexture(GL_TEXTURE_2D, texture_gl_handles[i]);
+            if (data->cooked.data() != nullptr)
+            {
+                // Straight from the mapped file, the mip chain is in there
+                for (GLint level = 0; level < (GLint)data->levels.size(); level++)
+                {
+                    const CookedTextureLevel& mip = data->levels[level];
+                    const unsigned char* payload = data->cooked.data() + mip.offset;
+                    if (data->header.format == CookedTextureFormat::BC3)
+                        glCompressedTexImage2D(GL_TEXTURE_2D, level, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, mip.width, mip.height, 0, (GLsizei)mip.size, payload);
+                    else
+                        glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, mip.width, mip.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, payload);
+                }
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)data->levels.size() - 1);
+                data->cooked.close();
+            }
+            else
+            {
+                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, dimensions.x, dimensions.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, data->pixels);
+                glGenerateMipmap(GL_TEXTURE_2D);
+                stbi_image_free(data->pixels);
+            }
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+            gl_has_errors();
+        }, true);
+        loads.depends_on(upload, decode);
     }
 	gl_has_errors();
 }
 
-void RenderSystem::initializeGlEffects()
+// What the read job of an effect hands to its compile job
+struct EffectSources
+{
+	std::string vs_str;
+	std::string fs_str;
+	uint64_t cache_key = 0;
+	ProgramBinary binary; // empty unless the cache has the program for these sources and driver
+};
+
+void RenderSystem::initializeGlEffects(JobGraph& loads)
 {
+	const bool use_program_cache = programBinariesSupported();
+	const std::string driver = glDriverDescription();
 	for(uint i = 0; i < effect_paths.size(); i++)
 	{
-		const std::string vertex_shader_name = effect_paths[i] + ".vs.glsl";
-		const std::string fragment_shader_name = effect_paths[i] + ".fs.glsl";
+		// The sources and the cached program are read on a worker, compiling needs the GL context
+		std::shared_ptr<EffectSources> sources = std::make_shared<EffectSources>();
+		JobGraph::JobId read = loads.add([this, i, sources, use_program_cache, driver]() {
+			const std::string vertex_shader_name = effect_paths[i] + ".vs.glsl";
+			const std::string fragment_shader_name = effect_paths[i] + ".fs.glsl";
+			bool is_read = readEffectSources(vertex_shader_name, fragment_shader_name, sources->vs_str, sources->fs_str);
+			assert(is_read);
+			(void)is_read;
+			sources->cache_key = programCacheKey(sources->vs_str, sources->fs_str, driver);
+			if (use_program_cache)
+				readProgramBinary(effect_paths[i] + ".program.bin", sources->cache_key, sources->binary);
+		});
+		JobGraph::JobId compile = loads.add([this, i, sources, use_program_cache]() {
+			if (!sources->binary.data.empty())
+			{
+				if (loadProgramBinary(sources->binary, effects[i]))
+					return;
+				fprintf(stderr, "The driver rejected the cached program of %s, compiling it\n", effect_paths[i].c_str());
+			}
+			bool is_valid = loadEffectFromSources(sources->vs_str, sources->fs_str, effects[i]);
+			assert(is_valid && (GLuint)effects[i] != 0);
+			if (is_valid && use_program_cache)
+				writeProgramBinary(effect_paths[i] + ".program.bin", sources->cache_key, effects[i]);
+		}, true);
+		loads.depends_on(compile, read);
+	}
+}
+
+void RenderSystem::watchShaders()
+{
+	std::vector<std::string> file_names;
+	for (const std::string& path : effect_paths)
+	{
+		std::string name = path.substr(path.find_last_of('/') + 1);
+		file_names.push_back(name + ".vs.glsl");
+		file_names.push_back(name + ".fs.glsl");
+	}
+	if (!shader_watcher.start(shader_path(""), file_names, [this](const std::string& file_name) { onShaderChanged(file_name); }))
+		fprintf(stderr, "Could not watch %s, shaders won't reload\n", shader_path("").c_str());
+}
 
-		bool is_valid = loadEffectFromFile(vertex_shader_name, fragment_shader_name, effects[i]);
-		assert(is_valid && (GLuint)effects[i] != 0);
+void RenderSystem::onShaderChanged(const std::string& file_name)
+{
+	const std::string effect_path = shader_path(file_name.substr(0, file_name.find('.')));
+	for (uint i = 0; i < effect_paths.size(); i++)
+	{
+		if (effect_paths[i] != effect_path)
+			continue;
+		EffectReload reload;
+		reload.effect = i;
+		if (!readEffectSources(effect_path + ".vs.glsl", effect_path + ".fs.glsl", reload.vs_str, reload.fs_str))
+			return;
+		std::lock_guard<std::mutex> lock(reload_mutex);
+		// Editors often write twice, the latest sources win
+		pending_reloads.erase(std::remove_if(pending_reloads.begin(), pending_reloads.end(),
+			[i](const EffectReload& pending) { return pending.effect == i; }), pending_reloads.end());
+		pending_reloads.push_back(reload);
 	}
 }
 
 // One could merge the following two functions as a template function...
-template <class T>
-void RenderSystem::bindVBOandIBO(GEOMETRY_BUFFER_ID gid, std::vector<T> vertices, std::vector<uint16_t> indices)
+template <class T, class I>
+void RenderSystem::bindVBOandIBO(GEOMETRY_BUFFER_ID gid, const std::vector<T>& vertices, const std::vector<I>& indices)
 {
+	static_assert(std::is_same<I, uint16_t>::value || std::is_same<I, uint32_t>::value, "Indices are 16 or 32 bit");
 	glBindBuffer(GL_ARRAY_BUFFER, vertex_buffers[(uint)gid]);
 	glBufferData(GL_ARRAY_BUFFER,
 		sizeof(vertices[0]) * vertices.size(), vertices.data(), GL_STATIC_DRAW);
@@ -111,28 +235,32 @@ void RenderSystem::bindVBOandIBO(GEOMETRY_BUFFER_ID gid, std::vector<T> vertices
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffers[(uint)gid]);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER,
 		sizeof(indices[0]) * indices.size(), indices.data(), GL_STATIC_DRAW);
+	index_types[(uint)gid] = sizeof(I) == sizeof(uint32_t) ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
 	gl_has_errors();
 }
 
-void RenderSystem::initializeGlMeshes()
+void RenderSystem::initializeGlMeshes(JobGraph& loads)
 {
 	for (uint i = 0; i < mesh_paths.size(); i++)
 	{
-		// Initialize meshes
+		// Initialize meshes, parsed on a worker and uploaded on the main thread
 		GEOMETRY_BUFFER_ID geom_index = mesh_paths[i].first;
-		std::string name = mesh_paths[i].second;
-		Mesh::loadFromOBJFile(name, 
-			meshes[(int)geom_index].vertices,
-			meshes[(int)geom_index].vertex_indices,
-			meshes[(int)geom_index].original_size);
-
-		bindVBOandIBO(geom_index,
-			meshes[(int)geom_index].vertices, 
-			meshes[(int)geom_index].vertex_indices);
+		JobGraph::JobId parse = loads.add([this, i, geom_index]() {
+			Mesh::loadCached(mesh_paths[i].second,
+				meshes[(int)geom_index].vertices,
+				meshes[(int)geom_index].vertex_indices,
+				meshes[(int)geom_index].original_size);
+		});
+		JobGraph::JobId upload = loads.add([this, geom_index]() {
+			bindVBOandIBO(geom_index,
+				meshes[(int)geom_index].vertices,
+				meshes[(int)geom_index].vertex_indices);
+		}, true);
+		loads.depends_on(upload, parse);
 	}
 }
 
-void RenderSystem::initializeGlGeometryBuffers()
+void RenderSystem::initializeGlGeometryBuffers(JobGraph& loads)
 {
 	// Vertex Buffer creation.
 	glGenBuffers((GLsizei)vertex_buffers.size(), vertex_buffers.data());
@@ -140,7 +268,7 @@ void RenderSystem::initializeGlGeometryBuffers()
 	glGenBuffers((GLsizei)index_buffers.size(), index_buffers.data());
 
 	// Index and Vertex buffer data initialization.
-	initializeGlMeshes();
+	initializeGlMeshes(loads);
 
 	//////////////////////////
 	// Initialize sprite
@@ -162,7 +290,7 @@ void RenderSystem::initializeGlGeometryBuffers()
 	////////////////////////
 	// Initialize pebble
 	std::vector<ColoredVertex> pebble_vertices;
-	std::vector<uint16_t> pebble_indices;
+	std::vector<uint32_t> pebble_indices;
 	constexpr float z = -0.1f;
 	constexpr int NUM_TRIANGLES = 62;
 
@@ -176,9 +304,9 @@ void RenderSystem::initializeGlGeometryBuffers()
 	pebble_vertices.back().position = { 0, 0, 0 };
 	pebble_vertices.back().color = { 0.8, 0.8, 0.8 };
 	for (int i = 0; i < NUM_TRIANGLES; i++) {
-		pebble_indices.push_back((uint16_t)i);
-		pebble_indices.push_back((uint16_t)((i + 1) % NUM_TRIANGLES));
-		pebble_indices.push_back((uint16_t)NUM_TRIANGLES);
+		pebble_indices.push_back((uint32_t)i);
+		pebble_indices.push_back((uint32_t)((i + 1) % NUM_TRIANGLES));
+		pebble_indices.push_back((uint32_t)NUM_TRIANGLES);
 	}
 	int geom_index = (int)GEOMETRY_BUFFER_ID::PEBBLE;
 	meshes[geom_index].vertices = pebble_vertices;
@@ -188,7 +316,7 @@ void RenderSystem::initializeGlGeometryBuffers()
 	//////////////////////////////////
 	// Initialize debug line
 	std::vector<ColoredVertex> line_vertices;
-	std::vector<uint16_t> line_indices;
+	std::vector<uint32_t> line_indices;
 
 	constexpr float depth = 0.5f;
 	constexpr vec3 red = { 0.8,0.1,0.1 };
@@ -223,6 +351,8 @@ void RenderSystem::initializeGlGeometryBuffers()
 
 RenderSystem::~RenderSystem()
 {
+	shader_watcher.stop();
+
 	// Don't need to free gl resources since they last for as long as the program,
 	// but it's polite to clean after yourself.
 	glDeleteBuffers((GLsizei)vertex_buffers.size(), vertex_buffers.data());
@@ -235,6 +365,7 @@ RenderSystem::~RenderSystem()
 	for(uint i = 0; i < effect_count; i++) {
 		glDeleteProgram(effects[i]);
 	}
+	gpu_timer.destroy();
 	// delete allocated resources
 	glDeleteFramebuffers(1, &frame_buffer);
 	gl_has_errors();
@@ -296,14 +427,20 @@ bool gl_compile_shader(GLuint shader)
 
 bool loadEffectFromFile(
 	const std::string& vs_path, const std::string& fs_path, GLuint& out_program)
+{
+	std::string vs_str, fs_str;
+	return readEffectSources(vs_path, fs_path, vs_str, fs_str) && loadEffectFromSources(vs_str, fs_str, out_program);
+}
+
+bool readEffectSources(
+	const std::string& vs_path, const std::string& fs_path, std::string& out_vs, std::string& out_fs)
 {
 	// Opening files
 	std::ifstream vs_is(vs_path);
 	std::ifstream fs_is(fs_path);
 	if (!vs_is.good() || !fs_is.good())
 	{
-		fprintf(stderr, "Failed to load shader files %s, %s", vs_path.c_str(), fs_path.c_str());
-		assert(false);
+		fprintf(stderr, "Failed to load shader files %s, %s\n", vs_path.c_str(), fs_path.c_str());
 		return false;
 	}
 
@@ -311,8 +448,14 @@ bool loadEffectFromFile(
 	std::stringstream vs_ss, fs_ss;
 	vs_ss << vs_is.rdbuf();
 	fs_ss << fs_is.rdbuf();
-	std::string vs_str = vs_ss.str();
-	std::string fs_str = fs_ss.str();
+	out_vs = vs_ss.str();
+	out_fs = fs_ss.str();
+	return true;
+}
+
+bool loadEffectFromSources(
+	const std::string& vs_str, const std::string& fs_str, GLuint& out_program)
+{
 	const char* vs_src = vs_str.c_str();
 	const char* fs_src = fs_str.c_str();
 	GLsizei vs_len = (GLsizei)vs_str.size();
@@ -325,16 +468,17 @@ bool loadEffectFromFile(
 	gl_has_errors();
 
 	// Compiling
+	// Failures are reported and left to the caller, a hot reloaded shader may well have a typo
 	if (!gl_compile_shader(vertex))
 	{
-		fprintf(stderr, "Vertex compilation failed");
-		assert(false);
+		fprintf(stderr, "Vertex compilation failed\n");
+		glDeleteShader(fragment);
 		return false;
 	}
 	if (!gl_compile_shader(fragment))
 	{
-		fprintf(stderr, "Vertex compilation failed");
-		assert(false);
+		fprintf(stderr, "Fragment compilation failed\n");
+		glDeleteShader(vertex);
 		return false;
 	}
 
@@ -342,6 +486,9 @@ bool loadEffectFromFile(
 	out_program = glCreateProgram();
 	glAttachShader(out_program, vertex);
 	glAttachShader(out_program, fragment);
+	// So that the program binary cache can read it back
+	if (glProgramParameteri != nullptr)
+		glProgramParameteri(out_program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 	glLinkProgram(out_program);
 	gl_has_errors();
 
@@ -358,7 +505,10 @@ bool loadEffectFromFile(
 			gl_has_errors();
 
 			fprintf(stderr, "Link error: %s", log.data());
-			assert(false);
+			glDeleteProgram(out_program);
+			glDeleteShader(vertex);
+			glDeleteShader(fragment);
+			out_program = 0;
 			return false;
 		}
 	}
@@ -0,0 +1,71 @@
+// internal
+#include "render_thread.hpp"
+#include "profiler.hpp"
+
+RenderThread::~RenderThread()
+{
+	stop();
+}
+
+void RenderThread::start(RenderSystem* renderer_arg)
+{
+	assert(!is_running());
+	renderer = renderer_arg;
+	write_index = 0;
+	ready_index = -1;
+	stopping = false;
+	// A context can only be current on one thread at a time
+	glfwMakeContextCurrent(nullptr);
+	thread = std::thread([this]() { loop(); });
+}
+
+void RenderThread::stop()
+{
+	if (!is_running())
+		return;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	changed.notify_all();
+	thread.join();
+	glfwMakeContextCurrent(renderer->getWindow());
+}
+
+void RenderThread::publish()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	{
+		// The render thread still draws the previous frame, e.g. it waits for vsync
+		PROFILE_SCOPE("render.wait");
+		changed.wait(lock, [this]() { return ready_index < 0 && !drawing; });
+	}
+	ready_index = write_index;
+	write_index = 1 - write_index;
+	lock.unlock();
+	changed.notify_all();
+}
+
+void RenderThread::loop()
+{
+	glfwMakeContextCurrent(renderer->getWindow());
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		changed.wait(lock, [this]() { return ready_index >= 0 || stopping; });
+		if (ready_index < 0)
+			break;
+		// The simulation only writes the other snapshot until the next publish, which waits for this frame
+		const RenderSnapshot& snapshot = snapshots[ready_index];
+		ready_index = -1;
+		drawing = true;
+		lock.unlock();
+		{
+			PROFILE_SCOPE("render.draw");
+			renderer->draw(snapshot);
+		}
+		lock.lock();
+		drawing = false;
+		changed.notify_all();
+	}
+	glfwMakeContextCurrent(nullptr);
+}
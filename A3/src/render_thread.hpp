@@ -0,0 +1,44 @@
+#pragma once
+
+// stlib
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// internal
+#include "render_system.hpp"
+
+// Draws on a thread of its own so that the simulation of the next step overlaps the drawing and the
+// vsync wait of the last one. The simulation captures into one of two snapshots while the render
+// thread draws the other, publish() hands the captured one over. At most one frame is in flight:
+// publish() waits until the render thread is done with the previous frame.
+// While it runs, the render thread owns the GL context.
+class RenderThread
+{
+public:
+	~RenderThread();
+
+	// Moves the GL context of the renderer's window to a new render thread
+	void start(RenderSystem* renderer);
+	// Draws the last published frame, then gives the GL context back to the calling thread
+	void stop();
+	bool is_running() const { return thread.joinable(); }
+
+	// The snapshot to capture the next frame into, only the simulation thread uses it
+	RenderSnapshot& next_snapshot() { return snapshots[write_index]; }
+	// Hands next_snapshot() over to the render thread
+	void publish();
+
+private:
+	void loop();
+
+	RenderSystem* renderer = nullptr;
+	RenderSnapshot snapshots[2];
+	int write_index = 0;
+	int ready_index = -1; // published and not yet taken by the render thread
+	bool drawing = false;
+	bool stopping = false;
+	std::mutex mutex;
+	std::condition_variable changed;
+	std::thread thread;
+};
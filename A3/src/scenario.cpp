@@ -0,0 +1,129 @@
+// internal
+#include "scenario.hpp"
+#include "profiler.hpp"
+#include "tiny_ecs_registry.hpp"
+#include "world_init.hpp"
+
+// stlib
+#include <algorithm>
+#include <cmath>
+#include <errno.h>
+#include <limits.h>
+#include <random>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+
+static bool parse_number(const std::string& text, double& out)
+{
+	char* end = nullptr;
+	errno = 0;
+	out = strtod(text.c_str(), &end);
+	return !text.empty() && *end == '\0' && errno == 0 && std::isfinite(out) && out >= 0;
+}
+
+// A whole number in [min, max], like the counts of loadGameConfig
+static bool parse_count(const std::string& text, double min, double max, double& out)
+{
+	return parse_number(text, out) && out >= min && out <= max && out == floor(out);
+}
+
+bool parseScenario(const std::string& text, Scenario& out_scenario)
+{
+	std::istringstream tokens(text);
+	std::string token;
+	while (tokens >> token) {
+		size_t equals = token.find('=');
+		std::string key = token.substr(0, equals);
+		std::string value = equals == std::string::npos ? "" : token.substr(equals + 1);
+		double number = 0, second = 0;
+		bool is_valid = true;
+		if (key == "placement") {
+			is_valid = value == "uniform" || value == "normal";
+			out_scenario.placement = value == "normal" ? Scenario::Placement::NORMAL : Scenario::Placement::UNIFORM;
+		}
+		else if (key == "speed") {
+			// min:max, or one speed for all
+			size_t colon = value.find(':');
+			is_valid = parse_number(value.substr(0, colon), number) &&
+				parse_number(colon == std::string::npos ? value.substr(0, colon) : value.substr(colon + 1), second) && number <= second;
+			out_scenario.min_speed = (float)number;
+			out_scenario.max_speed = (float)second;
+		}
+		else if (key == "fish" || key == "turtles" || key == "pebbles" || key == "seed" || key == "ticks") {
+			// A run needs at least one tick to end, the seed and ticks are 32 bit
+			bool is_32_bit = key == "seed" || key == "ticks";
+			is_valid = parse_count(value, key == "ticks" ? 1 : 0, is_32_bit ? UINT_MAX : 1e12, number);
+			size_t count = is_valid ? (size_t)number : 0; // casting an out of range double is undefined
+			if (key == "fish") out_scenario.fish = count;
+			else if (key == "turtles") out_scenario.turtles = count;
+			else if (key == "pebbles") out_scenario.pebbles = count;
+			else if (key == "seed") out_scenario.seed = (unsigned int)count;
+			else out_scenario.ticks = (unsigned int)count;
+		}
+		else
+			is_valid = false;
+		if (!is_valid) {
+			fprintf(stderr, "Scenario: can't use '%s', expected fish=, turtles=, pebbles=, placement=uniform|normal, speed=min:max, ticks= or seed= (counts are whole numbers, ticks at least 1)\n", token.c_str());
+			return false;
+		}
+	}
+	return true;
+}
+
+void populateScenario(const Scenario& scenario, RenderSystem* renderer, vec2 area)
+{
+	std::default_random_engine rng(scenario.seed);
+	std::uniform_real_distribution<float> uniform_dist; // number between 0..1
+	std::normal_distribution<float> normal_dist;
+	auto random_position = [&]() {
+		vec2 position;
+		if (scenario.placement == Scenario::Placement::NORMAL)
+			position = area * 0.5f + vec2(normal_dist(rng), normal_dist(rng)) * (area / 6.f);
+		else
+			position = vec2(uniform_dist(rng), uniform_dist(rng)) * area;
+		return glm::clamp(position, vec2(0.f), area);
+	};
+	auto random_velocity = [&]() {
+		float angle = uniform_dist(rng) * 2.f * (float)M_PI;
+		float speed = scenario.min_speed + uniform_dist(rng) * (scenario.max_speed - scenario.min_speed);
+		return vec2(cos(angle), sin(angle)) * speed;
+	};
+
+	// Like the spawning in WorldSystem::step
+	for (size_t i = 0; i < scenario.fish; i++) {
+		Entity entity = createFish(renderer, random_position());
+		registry.motions.get(entity).velocity = random_velocity();
+	}
+	for (size_t i = 0; i < scenario.turtles; i++) {
+		Entity entity = createTurtle(renderer, random_position());
+		Motion& motion = registry.motions.get(entity);
+		motion.velocity = random_velocity();
+		Physics& physics = registry.physics.get(entity);
+		physics.radius = motion.scale.x * 0.8f;
+		physics.mass = 1000;
+	}
+	for (size_t i = 0; i < scenario.pebbles; i++) {
+		float diameter = 5.f + uniform_dist(rng) * 35.f; // 50 units = 1m
+		Entity entity = createPebble(random_position(), { diameter, diameter });
+		registry.motions.get(entity).velocity = random_velocity();
+		Physics& physics = registry.physics.get(entity);
+		physics.mass = (float)(((4. / 3) * M_PI * pow((diameter / 2. / 50.), 3)) * 2000); // rock of 2000 kg/m3
+		physics.radius = diameter * 0.5f;
+		physics.coefficient_of_resititution = 0.3f;
+	}
+}
+
+void printScenarioReport(const Scenario& scenario, unsigned int ticks, double wall_ms, const std::vector<const char*>& scopes)
+{
+	size_t entities = registry.motions.size();
+	double ticks_per_second = ticks / (wall_ms / 1000.0);
+	printf("Scenario: %zu fish, %zu turtles, %zu pebbles (%zu moving entities at the end), %u ticks\n",
+		scenario.fish, scenario.turtles, scenario.pebbles, entities, ticks);
+	printf("  %.3f ms per tick, %.1f ticks/s, %.0f entity updates/s\n", wall_ms / ticks, ticks_per_second, entities * ticks_per_second);
+	printf("  %-28s %10s %10s\n", "scope", "p50 ms", "p99 ms");
+	for (const char* scope : scopes) {
+		Profiler::ScopeStats stats = profiler.stats(scope);
+		printf("  %-28s %10.3f %10.3f\n", scope, stats.p50_ms, stats.p99_ms);
+	}
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+// stlib
+#include <string>
+#include <vector>
+
+// internal
+#include "common.hpp"
+#include "render_system.hpp"
+
+// A stress test population for scaling measurements: N fish, M turtles and K pebbles made by createFish,
+// createTurtle and createPebble, placed and launched from seeded random distributions, and the number of
+// fixed 1/60 s ticks to run. Written as e.g. "fish=1000 turtles=100 pebbles=500 placement=normal speed=50:200 ticks=600 seed=7",
+// left out keys keep the defaults below.
+struct Scenario
+{
+	enum class Placement
+	{
+		UNIFORM, // anywhere in the area
+		NORMAL,  // around the center, with a standard deviation of a sixth of the area
+	};
+
+	size_t fish = 0;
+	size_t turtles = 0;
+	size_t pebbles = 0;
+	Placement placement = Placement::UNIFORM;
+	float min_speed = 50.f;  // units/s, in a random direction
+	float max_speed = 200.f;
+	unsigned int seed = 427;
+	unsigned int ticks = 600;
+};
+
+// False (with a message) on an unknown key or a bad value, e.g. a fractional or out of range count or ticks=0
+bool parseScenario(const std::string& text, Scenario& out_scenario);
+
+// Adds the scenario's entities to the registry, positioned in [0, area]
+void populateScenario(const Scenario& scenario, RenderSystem* renderer, vec2 area);
+
+// Prints the throughput of a run and the p50/p99 of the given profiler scopes over its last ticks (at most Profiler::HISTORY_FRAMES)
+void printScenarioReport(const Scenario& scenario, unsigned int ticks, double wall_ms, const std::vector<const char*>& scopes);
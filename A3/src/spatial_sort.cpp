@@ -0,0 +1,69 @@
+// internal
+#include "spatial_sort.hpp"
+#include "profiler.hpp"
+#include "tiny_ecs_registry.hpp"
+
+// stlib
+#include <algorithm>
+#include <vector>
+
+// Spreads the lower 16 bits out to the even bits
+static uint32_t part_1_by_1(uint32_t x)
+{
+	x &= 0x0000ffff;
+	x = (x | (x << 8)) & 0x00ff00ff;
+	x = (x | (x << 4)) & 0x0f0f0f0f;
+	x = (x | (x << 2)) & 0x33333333;
+	x = (x | (x << 1)) & 0x55555555;
+	return x;
+}
+
+uint32_t mortonCode(vec2 position, vec2 area)
+{
+	vec2 normalized = glm::clamp(position / area, vec2(0.f), vec2(1.f));
+	uint32_t x = (uint32_t)(normalized.x * 65535.f);
+	uint32_t y = (uint32_t)(normalized.y * 65535.f);
+	return part_1_by_1(x) | (part_1_by_1(y) << 1);
+}
+
+// The key of each component of the container being sorted, kept to not allocate again
+static std::vector<uint32_t> sort_keys;
+
+// Most of the time only a few entities moved far enough to change places since the last sort, those are
+// swapped into place. After a restart or a burst of spawns, or when an entity crossed the screen, a full sort
+// is cheaper: it does about one map lookup per entity, a swap does two.
+template <class Component>
+static void sort_adaptively(ComponentContainer<Component>& container)
+{
+	size_t out_of_order = 0;
+	for (size_t i = 1; i < sort_keys.size(); i++)
+		out_of_order += sort_keys[i] < sort_keys[i - 1];
+	if (out_of_order * 16 < sort_keys.size() && container.sort_incremental_by_key(sort_keys, sort_keys.size() / 2))
+		return;
+	container.sort_by_key(sort_keys);
+}
+
+// Orders the entities of a container like registry.motions, the ones without a motion go last
+template <class Component>
+static void sort_like_motions(ComponentContainer<Component>& container)
+{
+	ComponentContainer<Motion>& motions = registry.motions;
+	sort_keys.resize(container.entities.size());
+	for (size_t i = 0; i < container.entities.size(); i++) {
+		Entity e = container.entities[i];
+		sort_keys[i] = (uint32_t)(motions.has(e) ? &motions.get(e) - motions.components.data() : motions.size());
+	}
+	sort_adaptively(container);
+}
+
+void sortSpatially(vec2 area)
+{
+	PROFILE_SCOPE("spatial_sort");
+	ComponentContainer<Motion>& motions = registry.motions;
+	sort_keys.resize(motions.components.size());
+	for (size_t i = 0; i < motions.components.size(); i++)
+		sort_keys[i] = mortonCode(motions.components[i].position, area);
+	sort_adaptively(motions);
+	// registry.bodies put the physics into the order of the motions already
+	sort_like_motions(registry.gravity);
+}
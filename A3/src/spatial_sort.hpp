@@ -0,0 +1,21 @@
+#pragma once
+
+// stlib
+#include <stdint.h>
+
+// internal
+#include "common.hpp"
+
+// Entities are appended to the containers as they spawn and swapped around as others are removed, so
+// neighbours in the world end up anywhere in memory. Sorting the containers along a Z-order curve puts
+// them next to each other again, the collision loops then walk the components nearly in order.
+
+// Interleaves the bits of the position quantized to 16 bits per axis over [0, area], positions outside
+// are clamped. Positions that are close mostly get close codes.
+uint32_t mortonCode(vec2 position, vec2 area);
+
+// Sorts registry.motions by the Morton code of the positions, the group registry.bodies keeps registry.physics
+// in the same order. Then registry.gravity is sorted into the order of the motions, so that joining it walks
+// all three forward together.
+// The entities move little between two sorts, which keeps the sorts cheap.
+void sortSpatially(vec2 area);
@@ -0,0 +1,168 @@
+// internal
+#include "system_scheduler.hpp"
+#include "profiler.hpp"
+#include "tiny_ecs_registry.hpp"
+
+// stlib
+#include <assert.h>
+#include <stdio.h>
+#include <typeinfo>
+
+const int MAX_LISTED_CONFLICTS = 4;
+
+static const char* resource_names[(int)SharedResource::RESOURCE_COUNT] = {
+	"entities", "debug flags", "debug lines", "frame arena", "audio"
+};
+
+// Changing an owned container swaps the components of the others in its OwningGroup, so the containers of a
+// group are declared together
+static ComponentSignature signature_of(const ContainerInterface& container)
+{
+	assert(container.signatures && "Only containers of the registry can be declared");
+	if (container.owner == nullptr)
+		return ComponentSignature(1) << container.signature_bit;
+	ComponentSignature signature = 0;
+	for (const ContainerInterface* owned : container.owner->owned()) {
+		assert(owned->signatures && "Only containers of the registry can be declared");
+		signature |= ComponentSignature(1) << owned->signature_bit;
+	}
+	return signature;
+}
+
+SystemAccess& SystemAccess::read(const ContainerInterface& container)
+{
+	reads |= signature_of(container);
+	return *this;
+}
+
+SystemAccess& SystemAccess::write(const ContainerInterface& container)
+{
+	writes |= signature_of(container);
+	return *this;
+}
+
+SystemAccess& SystemAccess::read(SharedResource resource)
+{
+	resource_reads |= 1u << (int)resource;
+	return *this;
+}
+
+SystemAccess& SystemAccess::write(SharedResource resource)
+{
+	resource_writes |= 1u << (int)resource;
+	return *this;
+}
+
+SystemAccess& SystemAccess::write_all()
+{
+	writes = ~ComponentSignature(0);
+	resource_writes = (1u << (int)SharedResource::RESOURCE_COUNT) - 1;
+	return *this;
+}
+
+SystemAccess& SystemAccess::on_main_thread()
+{
+	main_thread = true;
+	return *this;
+}
+
+bool SystemAccess::conflicts_with(const SystemAccess& other) const
+{
+	bool containers = (writes & (other.reads | other.writes)) || (reads & other.writes);
+	bool resources = (resource_writes & (other.resource_reads | other.resource_writes)) || (resource_reads & other.resource_writes);
+	return containers || resources;
+}
+
+SystemScheduler::SystemId SystemScheduler::add(const char* name, const SystemAccess& access, std::function<void()> fn)
+{
+	assert(!built && "Add all systems before the first run");
+	System system;
+	system.name = name;
+	system.access = access;
+	system.fn = std::move(fn);
+	system.declared.reset(new DeclaredAccess());
+	system.declared->system = name;
+	system.declared->reads = access.reads | access.writes;
+	system.declared->writes = access.writes;
+	systems.push_back(std::move(system));
+	return systems.size() - 1;
+}
+
+void SystemScheduler::set_enabled(SystemId system, bool enabled)
+{
+	systems[system].enabled = enabled;
+}
+
+// Every system depends on the conflicting systems before it, leaving out the ones it already waits
+// for through another dependency. Walking backwards finds the closest ones first.
+void SystemScheduler::build()
+{
+	assert(systems.size() <= 64 && "The predecessor sets are 64 bit masks");
+	std::vector<uint64_t> predecessors(systems.size(), 0);
+	for (SystemId system = 0; system < systems.size(); system++) {
+		for (SystemId before = system; before-- > 0;) {
+			if (!systems[system].access.conflicts_with(systems[before].access))
+				continue;
+			if ((predecessors[system] >> before) & 1)
+				continue;
+			systems[system].dependencies.push_back(before);
+			predecessors[system] |= predecessors[before] | (uint64_t(1) << before);
+		}
+		System* scheduled = &systems[system];
+		JobGraph::JobId job = graph.add([this, scheduled]() { run_system(*scheduled); }, scheduled->access.main_thread);
+		assert(job == system);
+		(void)job;
+		for (SystemId dependency : systems[system].dependencies)
+			graph.depends_on(system, dependency);
+	}
+	built = true;
+#ifndef NDEBUG
+	print_graph();
+#endif
+}
+
+void SystemScheduler::run_system(System& system)
+{
+	if (!system.enabled)
+		return;
+	ScopedTimer timer(system.name);
+	DeclaredAccess* outer_access = declared_access;
+	declared_access = system.declared.get();
+	system.fn();
+	declared_access = outer_access;
+}
+
+void SystemScheduler::run()
+{
+	if (!built)
+		build();
+	graph.run();
+}
+
+void SystemScheduler::print_graph() const
+{
+	printf("System schedule:\n");
+	for (const System& system : systems) {
+		printf("  %s%s\n", system.name, system.access.main_thread ? " (main thread)" : "");
+		if (system.dependencies.empty())
+			printf("    no dependencies\n");
+		for (SystemId dependency : system.dependencies) {
+			const SystemAccess& a = system.access;
+			const SystemAccess& b = systems[dependency].access;
+			ComponentSignature containers = (a.writes & (b.reads | b.writes)) | (a.reads & b.writes);
+			uint32_t resources = (a.resource_writes & (b.resource_reads | b.resource_writes)) | (a.resource_reads & b.resource_writes);
+			printf("    after %s:", systems[dependency].name);
+			// A sync point conflicts on everything, only name the first few
+			int listed = 0;
+			for (unsigned int bit = 0; bit < registry.container_count(); bit++)
+				if (((containers >> bit) & 1) && listed++ < MAX_LISTED_CONFLICTS)
+					printf(" %s", typeid(registry.container(bit)).name());
+			for (int resource = 0; resource < (int)SharedResource::RESOURCE_COUNT; resource++)
+				if (((resources >> resource) & 1) && listed++ < MAX_LISTED_CONFLICTS)
+					printf(" [%s]", resource_names[resource]);
+			if (listed > MAX_LISTED_CONFLICTS)
+				printf(" and %d more", listed - MAX_LISTED_CONFLICTS);
+			printf("\n");
+		}
+	}
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+// stlib
+#include <functional>
+#include <memory>
+#include <stdint.h>
+#include <vector>
+
+// internal
+#include "thread_pool.hpp"
+#include "tiny_ecs.hpp"
+
+// State outside of the registry that several systems use, declared like the containers
+enum class SharedResource
+{
+	ENTITIES = 0,    // creating entities (ids and EntityPools), queueing destroys and immediate inserts and removes (they update the shared signatures)
+	DEBUG_FLAGS = 1, // the global debugging switches
+	DEBUG_LINES = 2, // the drawDebugLine queue
+	FRAME_ARENA = 3, // frame_arena allocations, e.g. FrameVector
+	AUDIO = 4,
+	RESOURCE_COUNT = 5
+};
+
+// The containers and resources a system reads and writes, e.g.
+// SystemAccess().read(registry.players).write(registry.motions).write(SharedResource::DEBUG_LINES)
+// A container owned by an OwningGroup stands for all containers of the group.
+struct SystemAccess
+{
+	ComponentSignature reads = 0;
+	ComponentSignature writes = 0;
+	uint32_t resource_reads = 0;
+	uint32_t resource_writes = 0;
+	bool main_thread = false;
+
+	SystemAccess& read(const ContainerInterface& container);
+	SystemAccess& write(const ContainerInterface& container);
+	SystemAccess& read(SharedResource resource);
+	SystemAccess& write(SharedResource resource);
+	// Every container and resource, e.g. for a sync point that applies the deferred changes
+	SystemAccess& write_all();
+	// Needs the GL context or the window, runs on the thread that called ThreadPool::init
+	SystemAccess& on_main_thread();
+
+	// Whether one of the two writes something the other reads or writes
+	bool conflicts_with(const SystemAccess& other) const;
+};
+
+// Runs the systems of a frame as a JobGraph derived from their declared access: a system waits for
+// every system added before it that it conflicts with, all others may run at the same time. The order
+// of add() is the order of the old hand written loop, so conflicting systems keep their order.
+// In debug builds the graph is printed once and every container a system uses without declaring it
+// is reported (see DeclaredAccess).
+class SystemScheduler
+{
+public:
+	typedef size_t SystemId;
+
+	SystemId add(const char* name, const SystemAccess& access, std::function<void()> fn);
+
+	// A disabled system is skipped, the systems after it still wait for the ones it depends on
+	void set_enabled(SystemId system, bool enabled);
+
+	// Runs all enabled systems and returns once they are done, the graph is built on the first run
+	void run();
+
+	size_t size() const { return systems.size(); }
+	// Also the name of the profiler scope the system runs in
+	const char* name(SystemId system) const { return systems[system].name; }
+
+	// Prints what each system waits for and the containers and resources behind it
+	void print_graph() const;
+
+private:
+	struct System
+	{
+		const char* name;
+		SystemAccess access;
+		std::function<void()> fn;
+		bool enabled = true;
+		std::unique_ptr<DeclaredAccess> declared; // shared by the system's jobs on all threads
+		std::vector<SystemId> dependencies;
+	};
+
+	void build();
+	void run_system(System& system);
+
+	std::vector<System> systems;
+	JobGraph graph;
+	bool built = false;
+};
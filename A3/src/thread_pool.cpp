@@ -0,0 +1,301 @@
+// internal
+#include "thread_pool.hpp"
+#include "tiny_ecs.hpp"
+
+// stlib
+#include <algorithm>
+#include <assert.h>
+
+ThreadPool thread_pool;
+
+// Index of the calling thread in ThreadPool::queues, 0 for the thread that called init
+static thread_local unsigned int current_thread_index = 0;
+
+// How often an idle worker looks for work before it goes to sleep
+const int IDLE_SPINS = 64;
+
+void ThreadPool::WorkQueue::push_back(const Task& task)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (count == ring.size()) {
+		// Unroll into a bigger ring, the queues only grow until they fit the largest parallel_for
+		std::vector<Task> bigger(std::max<size_t>(64, ring.size() * 2));
+		for (size_t i = 0; i < count; i++)
+			bigger[i] = ring[(head + i) % ring.size()];
+		ring.swap(bigger);
+		head = 0;
+	}
+	ring[(head + count) % ring.size()] = task;
+	count++;
+}
+
+bool ThreadPool::WorkQueue::pop_back(Task& task)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (count == 0)
+		return false;
+	count--;
+	task = ring[(head + count) % ring.size()];
+	return true;
+}
+
+bool ThreadPool::WorkQueue::pop_front(Task& task)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (count == 0)
+		return false;
+	task = ring[head];
+	head = (head + 1) % ring.size();
+	count--;
+	return true;
+}
+
+ThreadPool::~ThreadPool()
+{
+	shutdown();
+}
+
+void ThreadPool::init(unsigned int num_threads)
+{
+	shutdown();
+	if (num_threads == 0)
+		num_threads = std::max(1u, std::thread::hardware_concurrency());
+
+	stopping = false;
+	current_thread_index = 0;
+	for (unsigned int i = 0; i < num_threads; i++)
+		queues.emplace_back(new WorkQueue());
+	for (unsigned int i = 1; i < num_threads; i++)
+		workers.emplace_back([this, i]() { worker_loop(i); });
+}
+
+void ThreadPool::shutdown()
+{
+	stopping = true;
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+	}
+	work_available.notify_all();
+	for (std::thread& worker : workers)
+		worker.join();
+	workers.clear();
+	queues.clear();
+}
+
+void ThreadPool::run(const Task& task)
+{
+	// The task works for the system that queued it, not for the one this thread may be waiting for
+	DeclaredAccess* waiting_access = declared_access;
+	declared_access = task.access;
+	task.fn(task.data, task.begin, task.end);
+	declared_access = waiting_access;
+	if (task.counter)
+		task.counter->fetch_sub(1);
+}
+
+// Own work first, then steal, starting with the next thread so that thieves spread out
+bool ThreadPool::try_run_one(unsigned int thread_index)
+{
+	Task task;
+	if (thread_index == 0 && main_thread_queue.pop_front(task)) {
+		run(task);
+		return true;
+	}
+	size_t num_queues = queues.size();
+	bool found = queues[thread_index]->pop_back(task);
+	for (size_t k = 1; k < num_queues && !found; k++)
+		found = queues[(thread_index + k) % num_queues]->pop_front(task);
+	if (!found)
+		return false;
+	queued_tasks--;
+	run(task);
+	return true;
+}
+
+// A worker counts itself as sleeping before it checks queued_tasks, and a producer counts the task
+// before it checks sleeping_workers, so either the worker sees the task or the producer sees the worker
+void ThreadPool::wake_workers()
+{
+	if (sleeping_workers.load() == 0)
+		return;
+	{
+		std::lock_guard<std::mutex> lock(sleep_mutex);
+	}
+	work_available.notify_all();
+}
+
+void ThreadPool::worker_loop(unsigned int thread_index)
+{
+	current_thread_index = thread_index;
+	while (!stopping) {
+		if (try_run_one(thread_index))
+			continue;
+		bool has_work = false;
+		for (int spin = 0; spin < IDLE_SPINS && !has_work && !stopping; spin++) {
+			std::this_thread::yield();
+			has_work = queued_tasks.load() > 0;
+		}
+		if (has_work)
+			continue;
+
+		sleeping_workers++;
+		{
+			std::unique_lock<std::mutex> lock(sleep_mutex);
+			work_available.wait(lock, [this]() { return stopping || queued_tasks.load() > 0; });
+		}
+		sleeping_workers--;
+	}
+}
+
+void ThreadPool::submit(const Task& task)
+{
+	if (workers.empty()) {
+		run(task);
+		return;
+	}
+	queued_tasks++;
+	queues[current_thread_index]->push_back(task);
+	wake_workers();
+}
+
+void ThreadPool::submit_main_thread(const Task& task)
+{
+	if (workers.empty() || current_thread_index == 0) {
+		run(task);
+		return;
+	}
+	main_thread_queue.push_back(task);
+}
+
+void ThreadPool::wait(std::atomic<size_t>& counter)
+{
+	while (counter.load() > 0) {
+		if (!queues.empty() && try_run_one(current_thread_index))
+			continue;
+		std::this_thread::yield();
+	}
+}
+
+static void run_function_chunk(void* fn, size_t begin, size_t end)
+{
+	(*(const std::function<void(size_t, size_t)>*)fn)(begin, end);
+}
+
+void ThreadPool::parallel_for(size_t count, size_t grain, const std::function<void(size_t, size_t)>& fn)
+{
+	if (count == 0)
+		return;
+	grain = std::max<size_t>(grain, 1);
+	size_t num_chunks = (count + grain - 1) / grain;
+
+	// Nothing to share, skip the synchronization
+	if (workers.empty() || num_chunks == 1) {
+		for (size_t begin = 0; begin < count; begin += grain)
+			fn(begin, std::min(count, begin + grain));
+		return;
+	}
+
+	// Pushed last to first, the owner pops from the back and starts at chunk 0 while thieves take the last chunks
+	std::atomic<size_t> remaining{ num_chunks };
+	queued_tasks += num_chunks;
+	for (size_t chunk = num_chunks; chunk-- > 0;) {
+		Task task;
+		task.fn = run_function_chunk;
+		task.data = (void*)&fn;
+		task.begin = chunk * grain;
+		task.end = std::min(count, task.begin + grain);
+		task.counter = &remaining;
+		task.access = declared_access;
+		queues[current_thread_index]->push_back(task);
+	}
+	wake_workers();
+	wait(remaining);
+}
+
+JobGraph::JobId JobGraph::add(std::function<void()> fn, bool main_thread)
+{
+	Job job;
+	job.fn = std::move(fn);
+	job.main_thread = main_thread;
+	jobs.push_back(std::move(job));
+	return jobs.size() - 1;
+}
+
+void JobGraph::depends_on(JobId job, JobId dependency)
+{
+	assert(job < jobs.size() && dependency < jobs.size());
+	assert(!reaches(job, dependency) && "The dependency would make a cycle, run() would never return");
+	jobs[dependency].dependents.push_back(job);
+	jobs[job].dependency_count++;
+}
+
+void JobGraph::clear()
+{
+	jobs.clear();
+}
+
+void JobGraph::run_job(void* data, size_t job_id, size_t)
+{
+	JobGraph& graph = *(JobGraph*)data;
+	const Job& job = graph.jobs[job_id];
+	job.fn();
+	// The last dependency to finish starts the job, on this thread's deque where its inputs are still in cache
+	for (JobId dependent : job.dependents)
+		if (graph.remaining_dependencies[dependent].fetch_sub(1) == 1)
+			graph.submit_job(dependent);
+}
+
+void JobGraph::submit_job(JobId job)
+{
+	ThreadPool::Task task;
+	task.fn = run_job;
+	task.data = this;
+	task.begin = job;
+	task.counter = &unfinished;
+	task.access = declared_access;
+	if (jobs[job].main_thread)
+		thread_pool.submit_main_thread(task);
+	else
+		thread_pool.submit(task);
+}
+
+// Depth first search along the dependents
+bool JobGraph::reaches(JobId from, JobId to) const
+{
+	std::vector<JobId> stack(1, from);
+	std::vector<bool> visited(jobs.size(), false);
+	while (!stack.empty()) {
+		JobId job = stack.back();
+		stack.pop_back();
+		if (job == to)
+			return true;
+		if (visited[job])
+			continue;
+		visited[job] = true;
+		for (JobId dependent : jobs[job].dependents)
+			stack.push_back(dependent);
+	}
+	return false;
+}
+
+void JobGraph::run()
+{
+	if (jobs.empty())
+		return;
+	if (remaining_capacity < jobs.size()) {
+		remaining_dependencies.reset(new std::atomic<size_t>[jobs.size()]);
+		remaining_capacity = jobs.size();
+	}
+	for (size_t i = 0; i < jobs.size(); i++)
+		remaining_dependencies[i] = jobs[i].dependency_count;
+	unfinished = jobs.size();
+
+	// Main thread jobs run right away when submitted from here, hand out the others first
+	for (size_t i = 0; i < jobs.size(); i++)
+		if (jobs[i].dependency_count == 0 && !jobs[i].main_thread)
+			submit_job(i);
+	for (size_t i = 0; i < jobs.size(); i++)
+		if (jobs[i].dependency_count == 0 && jobs[i].main_thread)
+			submit_job(i);
+	thread_pool.wait(unfinished);
+}
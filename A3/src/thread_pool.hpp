@@ -0,0 +1,126 @@
+#pragma once
+
+// stlib
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct DeclaredAccess;
+
+// A work-stealing job system that systems can hand data-parallel loops and task graphs to.
+// Every thread owns a deque of tasks: it pushes and pops its own work at the back and, when it runs
+// dry, steals from the front of the other threads' deques. The thread that called init() is
+// thread 0 and runs tasks whenever it waits, so a pool of size 1 simply runs everything inline.
+class ThreadPool
+{
+public:
+	// A unit of work, runs fn(data, begin, end) and then decrements counter
+	struct Task {
+		void (*fn)(void* data, size_t begin, size_t end) = nullptr;
+		void* data = nullptr;
+		size_t begin = 0;
+		size_t end = 0;
+		std::atomic<size_t>* counter = nullptr;
+		DeclaredAccess* access = nullptr; // of the system that queued the task, see declared_access
+	};
+
+	ThreadPool() {}
+	~ThreadPool();
+
+	// (Re)starts the pool with num_threads threads including the caller, 0 picks one per core
+	void init(unsigned int num_threads = 0);
+
+	// Number of threads that run jobs, including the calling thread
+	unsigned int size() const { return queues.empty() ? 1 : (unsigned int)queues.size(); }
+
+	// Splits [0, count) into chunks of at most 'grain' elements and calls fn(begin, end) for each
+	// chunk on the workers and the calling thread. Returns once every chunk is done.
+	// The chunk boundaries only depend on count and grain, never on the number of threads.
+	// Can be called from inside a task, the waiting thread keeps running other tasks.
+	void parallel_for(size_t count, size_t grain, const std::function<void(size_t, size_t)>& fn);
+
+	// Pushes a task on the calling thread's deque, without workers it runs right away
+	void submit(const Task& task);
+
+	// Queues a task that only the thread that called init() runs, the next time it waits.
+	// For work that needs the GL context or the window. Runs right away when called from that thread.
+	void submit_main_thread(const Task& task);
+
+	// Runs tasks until counter drops to 0
+	void wait(std::atomic<size_t>& counter);
+
+private:
+	// A deque of tasks guarded by its own lock, so that owners and thieves rarely meet
+	class WorkQueue
+	{
+	public:
+		void push_back(const Task& task);
+		bool pop_back(Task& task);  // the owner takes its newest task, it is likely still in cache
+		bool pop_front(Task& task); // thieves take the oldest one, usually the largest piece of work left
+
+	private:
+		std::mutex mutex;
+		std::vector<Task> ring; // circular, grows when full
+		size_t head = 0;
+		size_t count = 0;
+	};
+
+	bool try_run_one(unsigned int thread_index);
+	void run(const Task& task);
+	void wake_workers();
+	void worker_loop(unsigned int thread_index);
+	void shutdown();
+
+	std::vector<std::thread> workers;
+	std::vector<std::unique_ptr<WorkQueue>> queues; // one per thread, queues[0] belongs to the thread that called init
+	WorkQueue main_thread_queue; // never stolen, not counted in queued_tasks so idle workers don't spin on it
+	std::atomic<size_t> queued_tasks{ 0 };
+	std::atomic<unsigned int> sleeping_workers{ 0 };
+	std::mutex sleep_mutex;
+	std::condition_variable work_available;
+	std::atomic<bool> stopping{ false };
+};
+
+extern ThreadPool thread_pool;
+
+// Jobs with dependencies, e.g. "integrate the positions, then the velocities and the collision
+// tests". Build the graph once and run() it every frame, a job starts as soon as all the jobs it
+// depends on are done and can use parallel_for itself.
+class JobGraph
+{
+public:
+	typedef size_t JobId;
+
+	// main_thread jobs only run on the thread that called ThreadPool::init, see submit_main_thread
+	JobId add(std::function<void()> fn, bool main_thread = false);
+
+	// job only starts after dependency finished
+	void depends_on(JobId job, JobId dependency);
+
+	size_t size() const { return jobs.size(); }
+	void clear();
+
+	// Runs every job on the thread pool and returns once all of them are done
+	void run();
+
+private:
+	struct Job {
+		std::function<void()> fn;
+		std::vector<JobId> dependents;
+		size_t dependency_count = 0;
+		bool main_thread = false;
+	};
+
+	static void run_job(void* graph, size_t job, size_t);
+	void submit_job(JobId job);
+	bool reaches(JobId from, JobId to) const;
+
+	std::vector<Job> jobs;
+	std::unique_ptr<std::atomic<size_t>[]> remaining_dependencies;
+	size_t remaining_capacity = 0;
+	std::atomic<size_t> unfinished{ 0 };
+};
@@ -1,5 +1,77 @@
 // internal
 #include "tiny_ecs.hpp"
 
+// stlib
+#include <stdio.h>
+#include <typeinfo>
+
 // All we need to store besides the containers is the id of every entity and callbacks to be able to remove entities across containers
-unsigned int Entity::id_count = 1;
\ No newline at end of file
+unsigned int Entity::id_count = 1;
+ContainerList* ContainerList::constructing = nullptr;
+thread_local DeclaredAccess* declared_access = nullptr;
+
+void ContainerInterface::report_undeclared_access(bool write)
+{
+	ComponentSignature bit = ComponentSignature(1) << signature_bit;
+	ComponentSignature declared = write ? declared_access->writes : declared_access->reads;
+	if ((declared & bit) || (declared_access->reported.fetch_or(bit) & bit))
+		return;
+	fprintf(stderr, "Access conflict: system '%s' %s %s without declaring it, the scheduler may run it alongside a system that %s it\n",
+		declared_access->system, write ? "writes" : "reads", typeid(*this).name(), write ? "reads" : "writes");
+}
+
+OwningGroup::OwningGroup(std::initializer_list<ContainerInterface*> owned)
+	: containers(owned)
+{
+	assert(containers.size() >= 2 && "A group joins at least two containers");
+	for (ContainerInterface* container : containers) {
+		assert(container->owner == nullptr && "A container can only be owned by one group");
+		container->owner = this;
+	}
+	// Pack the entities the containers already share, every index before i is either a member or was checked
+	ContainerInterface& first = *containers[0];
+	unsigned int count = (unsigned int)first.size();
+	for (unsigned int i = 0; i < count; i++)
+		on_insert(first.entity_at(i));
+}
+
+void OwningGroup::on_insert(Entity e)
+{
+	unsigned int index;
+	for (ContainerInterface* container : containers)
+		if (!container->find_index(e, index))
+			return;
+	// Each container has e past the members, move it right behind them
+	for (ContainerInterface* container : containers) {
+		container->find_index(e, index);
+		assert(index >= members && "Entity already in the group");
+		container->swap_at(index, members);
+	}
+	members++;
+}
+
+void OwningGroup::on_remove(Entity e)
+{
+	// A member has a component in every container, swap it with the last member
+	unsigned int index;
+	for (ContainerInterface* container : containers) {
+		bool found = container->find_index(e, index);
+		assert(found && index < members && "Entity not in the group");
+		(void)found;
+		container->swap_at(index, members - 1);
+	}
+	members--;
+}
+
+void OwningGroup::align_to(ContainerInterface& leader)
+{
+	for (ContainerInterface* container : containers) {
+		if (container == &leader)
+			continue;
+		for (unsigned int i = 0; i < members; i++) {
+			unsigned int index;
+			container->find_index(leader.entity_at(i), index);
+			container->swap_at(i, index);
+		}
+	}
+}
@@ -1,11 +1,14 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
 #include <vector>
 #include <unordered_map>
 #include <set>
 #include <functional>
+#include <initializer_list>
 #include <typeindex>
+#include <stdint.h>
 #include <assert.h>
 
 // Unique identifyer for all entities
@@ -22,13 +25,264 @@ public:
 	operator unsigned int() { return id; } // this enables automatic casting to int
 };
 
+// Free list shared by all copies of a NodePoolAllocator. Blocks of the size first requested for a
+// single object (the hash map nodes) are kept for re-use instead of being freed, so removing and
+// re-inserting entities does not touch the heap once the container has warmed up.
+struct NodeFreeList
+{
+	size_t block_bytes = 0;
+	void* head = nullptr;
+	size_t free_blocks = 0;
+
+	NodeFreeList() {}
+	NodeFreeList(const NodeFreeList&) = delete; // allocators point to it, it must stay in place
+	NodeFreeList& operator=(const NodeFreeList&) = delete;
+	~NodeFreeList()
+	{
+		while (head) {
+			void* next = *(void**)head;
+			::operator delete(head);
+			head = next;
+		}
+	}
+};
+
+// Allocator for the entity -> index hash map of a ComponentContainer, recycles nodes through a NodeFreeList
+template <typename T>
+struct NodePoolAllocator
+{
+	typedef T value_type;
+	NodeFreeList* free_list;
+
+	NodePoolAllocator(NodeFreeList* free_list) : free_list(free_list) {}
+	template <typename U>
+	NodePoolAllocator(const NodePoolAllocator<U>& other) : free_list(other.free_list) {}
+
+	T* allocate(size_t n)
+	{
+		size_t bytes = n * sizeof(T);
+		if (free_list->block_bytes == 0 && n == 1 && bytes >= sizeof(void*))
+			free_list->block_bytes = bytes;
+		if (bytes == free_list->block_bytes && free_list->head) {
+			void* block = free_list->head;
+			free_list->head = *(void**)block;
+			free_list->free_blocks--;
+			return (T*)block;
+		}
+		return (T*)::operator new(bytes);
+	}
+
+	void deallocate(T* p, size_t n)
+	{
+		if (n * sizeof(T) == free_list->block_bytes) {
+			*(void**)p = free_list->head;
+			free_list->head = p;
+			free_list->free_blocks++;
+		}
+		else
+			::operator delete(p);
+	}
+
+	template <typename U>
+	bool operator==(const NodePoolAllocator<U>& other) const { return free_list == other.free_list; }
+	template <typename U>
+	bool operator!=(const NodePoolAllocator<U>& other) const { return free_list != other.free_list; }
+};
+
+// One bit per registered container, set while the entity has a component of that type
+typedef uint64_t ComponentSignature;
+const unsigned int max_component_types = 64;
+
+// The component signature of every entity that has at least one component
+struct EntitySignatures
+{
+	typedef NodePoolAllocator<std::pair<const unsigned int, ComponentSignature>> MapAllocator;
+	NodeFreeList map_free_list; // declared before the map so that it outlives it
+	std::unordered_map<unsigned int, ComponentSignature, std::hash<unsigned int>, std::equal_to<unsigned int>, MapAllocator> map_entity_signature;
+
+	EntitySignatures() : map_entity_signature(MapAllocator(&map_free_list)) {}
+
+	ComponentSignature get(unsigned int entity) const
+	{
+		auto it = map_entity_signature.find(entity);
+		return it == map_entity_signature.end() ? 0 : it->second;
+	}
+
+	void set(unsigned int entity, unsigned int bit)
+	{
+		map_entity_signature[entity] |= ComponentSignature(1) << bit;
+	}
+
+	void reset(unsigned int entity, unsigned int bit)
+	{
+		auto it = map_entity_signature.find(entity);
+		if (it == map_entity_signature.end())
+			return;
+		it->second &= ~(ComponentSignature(1) << bit);
+		if (it->second == 0)
+			map_entity_signature.erase(it); // entities without components don't take up space
+	}
+
+	void clear() { map_entity_signature.clear(); }
+};
+
+// The containers a running system declared it reads and writes, by signature bit, see SystemScheduler.
+// In debug builds the container functions report every container the system uses without declaring it.
+// Loops over the public components and entities vectors don't go through a function and aren't checked.
+struct DeclaredAccess
+{
+	const char* system = "";
+	ComponentSignature reads = 0;  // a write implies a read
+	ComponentSignature writes = 0;
+	std::atomic<ComponentSignature> reported{ 0 }; // each undeclared container is reported once, by any of the system's jobs
+};
+
+// Access of the system the calling thread works for, thread pool tasks inherit it from the thread that queued them
+extern thread_local DeclaredAccess* declared_access;
+
+// Memory and occupancy of one container, see ContainerInterface::stats
+struct ContainerStats
+{
+	const char* type_name = ""; // typeid name of the component
+	size_t count = 0;           // components stored
+	size_t capacity = 0;        // components the vector has room for
+	size_t bucket_count = 0;    // hash map buckets
+	float load_factor = 0;      // hash map entries per bucket
+	size_t free_nodes = 0;      // recycled hash map nodes waiting for re-use
+	size_t pending = 0;         // queued deferred inserts and removes
+	size_t bytes = 0;           // approximate heap memory of the vectors, the buckets and the map nodes
+};
+
+// Heap memory of a hash map with the given node type, buckets are a pointer each
+template <typename Map>
+size_t approximate_map_bytes(const Map& map, size_t free_nodes)
+{
+	// libstdc++ nodes hold a next pointer, the value and the cached hash
+	const size_t node_bytes = sizeof(void*) + sizeof(typename Map::value_type) + sizeof(size_t);
+	return map.bucket_count() * sizeof(void*) + (map.size() + free_nodes) * node_bytes;
+}
+
+class OwningGroup;
+
 // Common interface to refer to all containers in the ECS registry
 struct ContainerInterface
 {
+	// Set when the container registers with a ContainerList, nullptr for stand-alone containers
+	EntitySignatures* signatures = nullptr;
+	unsigned int signature_bit = 0;
+	// The group that orders this container, if any
+	OwningGroup* owner = nullptr;
+
 	virtual void clear() = 0;
 	virtual size_t size() = 0;
 	virtual void remove(Entity e) = 0;
 	virtual bool has(Entity entity) = 0;
+	virtual ContainerStats stats() = 0;
+	// Applies the queued inserts and removes and removes the (sorted) destroyed entities, in one pass.
+	// holds_destroyed is false when none of the destroyed entities has a component in this container.
+	virtual void apply_deferred(const std::vector<Entity>& destroyed, bool holds_destroyed) = 0;
+
+	// For the bookkeeping of an OwningGroup, these don't check the access of the running system
+	virtual bool find_index(Entity e, unsigned int& out_index) = 0;
+	virtual Entity entity_at(unsigned int index) = 0;
+	virtual void swap_at(unsigned int a, unsigned int b) = 0;
+
+	// Reports the access if the running system didn't declare it, compiled out in release builds
+	void check_access(bool write)
+	{
+#ifndef NDEBUG
+		if (declared_access && signatures)
+			report_undeclared_access(write);
+#else
+		(void)write;
+#endif
+	}
+
+private:
+	void report_undeclared_access(bool write);
+};
+
+// Orders entities by id, e.g., to sort and search the deferred destroys
+inline bool entity_less(Entity a, Entity b) { return (unsigned int)a < (unsigned int)b; }
+
+// The containers of a registry and the component signatures of its entities.
+// Declare it before the containers: every ComponentContainer constructed after it adds itself
+// and gets the next signature bit, until the owner calls seal() at the end of its constructor.
+// This way no container can be forgotten when removing entities.
+class ContainerList
+{
+public:
+	ContainerList()
+	{
+		assert(constructing == nullptr && "Only one registry can be constructed at a time");
+		constructing = this;
+	}
+	ContainerList(const ContainerList&) = delete; // the containers point to its signatures
+	ContainerList& operator=(const ContainerList&) = delete;
+
+	// Stop adding containers, call at the end of the owner's constructor
+	void seal()
+	{
+		if (constructing == this)
+			constructing = nullptr;
+	}
+
+	// Called by the container constructor
+	static void register_container(ContainerInterface* container)
+	{
+		if (constructing == nullptr)
+			return;
+		assert(constructing->containers.size() < max_component_types && "Too many component types for a ComponentSignature");
+		container->signatures = &constructing->signatures;
+		container->signature_bit = (unsigned int)constructing->containers.size();
+		constructing->containers.push_back(container);
+	}
+
+	std::vector<ContainerInterface*>::iterator begin() { return containers.begin(); }
+	std::vector<ContainerInterface*>::iterator end() { return containers.end(); }
+	size_t size() const { return containers.size(); }
+	ContainerInterface* operator[](size_t i) { return containers[i]; }
+
+	EntitySignatures signatures;
+
+private:
+	std::vector<ContainerInterface*> containers;
+	static ContainerList* constructing;
+};
+
+// An owning group in the style of EnTT: the entities that have a component in every one of its containers are
+// kept at the front of each container, in the same order. Index i < size() of all owned containers belongs to
+// the same entity, so a system joins them by walking the arrays side by side without any lookups, e.g.
+//   for (unsigned int i = 0; i < registry.bodies.size(); i++)
+//       step(registry.motions.components[i], registry.physics.components[i]);
+// Inserting or removing a component of an owned type may move other components of the owned containers, a
+// reference into an owned container is only valid until the next insert or remove of any of them. For the
+// same reason SystemAccess declares a read or write of an owned container for all of them.
+// A container can only be owned by one group. Sorting an owned container sorts the members and the other
+// entities separately and then puts the members of the other owned containers into the same order.
+class OwningGroup
+{
+public:
+	OwningGroup(std::initializer_list<ContainerInterface*> owned);
+	OwningGroup(const OwningGroup&) = delete; // the containers point to it
+	OwningGroup& operator=(const OwningGroup&) = delete;
+
+	// Number of entities with all the components, the first size() of each owned container
+	unsigned int size() const { return members; }
+
+	// Called by the owned containers after inserting and before removing a component
+	void on_insert(Entity e);
+	void on_remove(Entity e);
+	void on_clear() { members = 0; }
+
+	// Puts the members of all other owned containers into the order of the leader's
+	void align_to(ContainerInterface& leader);
+
+	const std::vector<ContainerInterface*>& owned() const { return containers; }
+
+private:
+	std::vector<ContainerInterface*> containers;
+	unsigned int members = 0;
 };
 
 // A container that stores components of type 'Component' and associated entities
@@ -36,8 +290,10 @@ template <typename Component> // A component can be any class
 class ComponentContainer : public ContainerInterface
 {
 private:
-	// The hash map from Entity -> array index.
-	std::unordered_map<unsigned int, unsigned int> map_entity_componentID; // the entity is cast to uint to be hashable.
+	// The hash map from Entity -> array index, its nodes are recycled through map_free_list.
+	typedef NodePoolAllocator<std::pair<const unsigned int, unsigned int>> MapAllocator;
+	NodeFreeList map_free_list; // declared before the map so that it outlives it
+	std::unordered_map<unsigned int, unsigned int, std::hash<unsigned int>, std::equal_to<unsigned int>, MapAllocator> map_entity_componentID; // the entity is cast to uint to be hashable.
 	bool registered = false;
 public:
 	// Container of all components of type 'Component'
@@ -46,9 +302,15 @@ public:
 	// The corresponding entities
 	std::vector<Entity> entities;
 
+	// Changes queued while systems iterate over the container, see apply_deferred
+	std::vector<std::pair<Entity, Component>> pending_inserts;
+	std::vector<Entity> pending_removes;
+
 	// Constructor that registers the type
 	ComponentContainer()
+		: map_entity_componentID(MapAllocator(&map_free_list))
 	{
+		ContainerList::register_container(this);
 	}
 
 	// Inserting a component c associated to entity e
@@ -56,10 +318,18 @@ public:
 	{
 		// Usually, every entity should only have one instance of each component type
 		assert(!(check_for_duplicates && has(e)) && "Entity already contained in ECS registry");
+		check_access(true);
 
 		map_entity_componentID[e] = (unsigned int)components.size();
 		components.push_back(std::move(c)); // the move enforces move instead of copy constructor
 		entities.push_back(e);
+		if (signatures)
+			signatures->set(e, signature_bit);
+		if (owner) {
+			// Joining the group moves the component to the end of the members
+			owner->on_insert(e);
+			return components[map_entity_componentID.find(e)->second];
+		}
 		return components.back();
 	};
 
@@ -74,64 +344,290 @@ public:
 	};
 
 	// A wrapper to return the component of an entity
+	// Only looks the entity up, so jobs on several threads may call it as long as nobody inserts or removes
 	Component& get(Entity e) {
-		assert(has(e) && "Entity not contained in ECS registry");
-		return components[map_entity_componentID[e]];
+		check_access(false);
+		auto it = map_entity_componentID.find(e);
+		assert(it != map_entity_componentID.end() && "Entity not contained in ECS registry");
+		return components[it->second];
 	}
 
 	// Check if entity has a component of type 'Component'
 	bool has(Entity entity) {
+		check_access(false);
 		return map_entity_componentID.count(entity) > 0;
 	}
 
 	// Remove an component and pack the container to re-use the empty space
 	void remove(Entity e)
 	{
+		check_access(true);
 		if (has(e))
-		{
-			// Get the current position
-			int cID = map_entity_componentID[e];
-
-			// Move the last element to position cID using the move operator
-			// Note, components[cID] = components.back() would trigger the copy instead of move operator
-			components[cID] = std::move(components.back());
-			entities[cID] = entities.back(); // the entity is only a single index, copy it.
-			map_entity_componentID[entities.back()] = cID;
-
-			// Erase the old component and free its memory
-			map_entity_componentID.erase(e);
-			components.pop_back();
-			entities.pop_back();
-			// Note, one could mark the id for re-use
-		}
+			remove_at(map_entity_componentID[e]);
+	};
+
+	// Queue inserting the component of entity e, or overwriting it if e already has one
+	void insert_deferred(Entity e, Component c)
+	{
+		check_access(true);
+		pending_inserts.emplace_back(e, std::move(c));
+	}
+	template<typename... Args>
+	void emplace_deferred(Entity e, Args &&... args) {
+		insert_deferred(e, Component(std::forward<Args>(args)...));
 	};
 
+	// Queue removing the component of entity e
+	void remove_deferred(Entity e)
+	{
+		check_access(true);
+		pending_removes.push_back(e);
+	}
+
+	// Applies all queued changes at a sync point: destroyed entities and queued removes go first,
+	// then the queued inserts, in the order they were made (later ones win). Inserts for entities
+	// destroyed in the same batch are dropped.
+	void apply_deferred(const std::vector<Entity>& destroyed, bool holds_destroyed = true)
+	{
+		check_access(true);
+		if (holds_destroyed && components.size() > 0 && destroyed.size() > 0) {
+			if (destroyed.size() < components.size()) {
+				for (Entity e : destroyed)
+					remove(e);
+			}
+			else {
+				// More destroys than components, walk the container instead of doing a lookup per destroy
+				for (int i = (int)entities.size() - 1; i >= 0; --i)
+					if (std::binary_search(destroyed.begin(), destroyed.end(), entities[i], entity_less))
+						remove_at(i);
+			}
+		}
+		for (Entity e : pending_removes)
+			remove(e);
+		for (std::pair<Entity, Component>& pending : pending_inserts) {
+			Entity e = pending.first;
+			if (std::binary_search(destroyed.begin(), destroyed.end(), e, entity_less))
+				continue;
+			if (has(e))
+				get(e) = std::move(pending.second);
+			else
+				insert(e, std::move(pending.second));
+		}
+		pending_inserts.clear();
+		pending_removes.clear();
+	}
+
 	// Remove all components of type 'Component'
 	void clear()
 	{
+		check_access(true);
+		if (signatures)
+			for (Entity e : entities)
+				signatures->reset(e, signature_bit);
 		map_entity_componentID.clear();
 		components.clear();
 		entities.clear();
+		pending_inserts.clear();
+		pending_removes.clear();
+		if (owner)
+			owner->on_clear();
 	}
 
 	// Report the number of components of type 'Component'
 	size_t size()
 	{
+		check_access(false);
 		return components.size();
 	}
 
-	// Sort the components and associated entity assignment structures by the comparisonFunction, see std::sort
+	// Report the memory and occupancy of the container
+	ContainerStats stats()
+	{
+		ContainerStats result;
+		result.type_name = typeid(*this).name();
+		result.count = components.size();
+		result.capacity = components.capacity();
+		result.bucket_count = map_entity_componentID.bucket_count();
+		result.load_factor = map_entity_componentID.load_factor();
+		result.free_nodes = map_free_list.free_blocks;
+		result.pending = pending_inserts.size() + pending_removes.size();
+		result.bytes = components.capacity() * sizeof(Component)
+			+ entities.capacity() * sizeof(Entity)
+			+ pending_inserts.capacity() * sizeof(std::pair<Entity, Component>)
+			+ pending_removes.capacity() * sizeof(Entity)
+			+ sort_order.capacity() * sizeof(unsigned int)
+			+ approximate_map_bytes(map_entity_componentID, map_free_list.free_blocks);
+		return result;
+	}
+
+private:
+	// Remove the component at array index cID by moving the last one into its place
+	void remove_at(unsigned int cID)
+	{
+		Entity e = entities[cID];
+		if (owner && cID < owner->size()) {
+			// Leaving the group moves the component to the end of the members, which the swap with the last one doesn't touch
+			owner->on_remove(e);
+			cID = map_entity_componentID.find(e)->second;
+		}
+
+		// Move the last element to position cID using the move operator
+		// Note, components[cID] = components.back() would trigger the copy instead of move operator
+		components[cID] = std::move(components.back());
+		entities[cID] = entities.back(); // the entity is only a single index, copy it.
+		map_entity_componentID[entities.back()] = cID;
+
+		// Erase the old component and free its memory
+		map_entity_componentID.erase(e);
+		components.pop_back();
+		entities.pop_back();
+		// Note, one could mark the id for re-use
+		// collisions may hold duplicates of the same entity, then the map points to another one of them and e keeps its bit
+		if (map_entity_componentID.size() < entities.size()) {
+			for (unsigned int i = 0; i < entities.size(); i++)
+				if (entities[i] == e) {
+					map_entity_componentID[e] = i;
+					return;
+				}
+		}
+		if (signatures)
+			signatures->reset(e, signature_bit);
+	}
+
+public:
+	// Sort the components and associated entity assignment structures by the comparisonFunction, see std::sort.
+	// Sorts a permutation of the indices, then moves the components and entities in place along its cycles and
+	// only rewrites the map entries of those that moved. Allocates only when the container grew past the
+	// largest size sorted so far. Each entity may only be in the container once.
 	template <class Compare>
 	void sort(Compare comparisonFunction)
 	{
-		// First sort the entity list as desired
-		std::sort(entities.begin(), entities.end(), comparisonFunction);
-		// Now re-arrange the components (Note, creates a new vector, which may be slow! Not sure if in-place could be faster: https://stackoverflow.com/questions/63703637/how-to-efficiently-permute-an-array-in-place-using-stdswap)
-		std::vector<Component> components_new; components_new.reserve(components.size());
-		std::transform(entities.begin(), entities.end(), std::back_inserter(components_new), [&](Entity e) { return std::move(get(e)); }); // note, the get still uses the old hash map (on purpose!)
-		components = std::move(components_new); // note, we use move operations to not create unneccesary copies of objects, but memory is still allocated for the new vector
-		// Fill the new hashmap
-		for (unsigned int i = 0; i < entities.size(); i++)
-			map_entity_componentID[entities[i]] = i;
+		check_access(true);
+		sort_indices([&](unsigned int a, unsigned int b) { return comparisonFunction(entities[a], entities[b]); });
+	}
+
+	// Sorts by keys[i], the key of components[i], so that a key computed from the component (e.g. a depth or a
+	// position code) is computed once per sort instead of on every comparison. keys isn't changed.
+	template <class Key>
+	void sort_by_key(const std::vector<Key>& keys)
+	{
+		check_access(true);
+		assert(keys.size() == entities.size());
+		sort_indices([&](unsigned int a, unsigned int b) { return keys[a] < keys[b]; });
+	}
+
+	// Sorts like sort, by swapping neighbours (insertion sort): O(n) for a container that is nearly sorted
+	// already, e.g. by depth or position each frame, and never allocates. The container stays consistent
+	// after every swap, so the comparisonFunction may look up components of this container.
+	template <class Compare>
+	void sort_incremental(Compare comparisonFunction)
+	{
+		check_access(true);
+		sort_incremental_indices([&](unsigned int a, unsigned int b) { return comparisonFunction(entities[a], entities[b]); },
+			[](unsigned int, unsigned int) {}, SIZE_MAX);
+	}
+
+	// Sorts like sort_by_key by swapping neighbours, keys is swapped along. A single entity that moved far costs
+	// as many swaps as the distance, so it gives up after max_swaps and returns false. The container and keys are
+	// then consistent but only partly sorted, e.g. for sort_by_key to finish.
+	template <class Key>
+	bool sort_incremental_by_key(std::vector<Key>& keys, size_t max_swaps)
+	{
+		check_access(true);
+		assert(keys.size() == entities.size());
+		return sort_incremental_indices([&](unsigned int a, unsigned int b) { return keys[a] < keys[b]; },
+			[&](unsigned int a, unsigned int b) { std::swap(keys[a], keys[b]); }, max_swaps);
+	}
+
+	bool find_index(Entity e, unsigned int& out_index)
+	{
+		auto it = map_entity_componentID.find(e);
+		if (it == map_entity_componentID.end())
+			return false;
+		out_index = it->second;
+		return true;
+	}
+
+	Entity entity_at(unsigned int index) { return entities[index]; }
+
+	void swap_at(unsigned int a, unsigned int b)
+	{
+		if (a == b)
+			return;
+		std::swap(components[a], components[b]);
+		std::swap(entities[a], entities[b]);
+		map_entity_componentID.find(entities[a])->second = a;
+		map_entity_componentID.find(entities[b])->second = b;
+	}
+
+private:
+	// Scratch of sort, kept to not allocate again
+	std::vector<unsigned int> sort_order;
+
+	// Sorts by indexLess on the current indices. The members of an owning group stay in front, the two ranges are
+	// sorted separately. The container doesn't change until the permutation is known, so indexLess may look up
+	// components of this container.
+	template <class IndexLess>
+	void sort_indices(IndexLess indexLess)
+	{
+		assert(map_entity_componentID.size() == entities.size() && "Can't sort a container with duplicate entities");
+		unsigned int members = owner ? owner->size() : 0;
+		// sort_order[i] is the index of the component that goes to index i
+		sort_order.resize(entities.size());
+		for (unsigned int i = 0; i < sort_order.size(); i++)
+			sort_order[i] = i;
+		std::sort(sort_order.begin(), sort_order.begin() + members, indexLess);
+		std::sort(sort_order.begin() + members, sort_order.end(), indexLess);
+
+		// Lift the first component of each cycle out, pull each one into the place it goes to, then put the
+		// first one down where the cycle ends
+		for (unsigned int start = 0; start < sort_order.size(); start++) {
+			if (sort_order[start] == start)
+				continue;
+			Component lifted = std::move(components[start]);
+			Entity lifted_entity = entities[start];
+			unsigned int to = start;
+			while (sort_order[to] != start) {
+				unsigned int from = sort_order[to];
+				components[to] = std::move(components[from]);
+				entities[to] = entities[from];
+				map_entity_componentID.find(entities[to])->second = to;
+				sort_order[to] = to;
+				to = from;
+			}
+			components[to] = std::move(lifted);
+			entities[to] = lifted_entity;
+			map_entity_componentID.find(lifted_entity)->second = to;
+			sort_order[to] = to;
+		}
+		if (owner)
+			owner->align_to(*this);
+	}
+
+	// Insertion sort of both ranges like sort_indices, false if it ran out of swaps
+	template <class IndexLess, class OnSwap>
+	bool sort_incremental_indices(IndexLess indexLess, OnSwap onSwap, size_t max_swaps)
+	{
+		unsigned int members = owner ? owner->size() : 0;
+		bool sorted = insertion_sort(0, members, indexLess, onSwap, max_swaps) &&
+			insertion_sort(members, (unsigned int)entities.size(), indexLess, onSwap, max_swaps);
+		if (owner)
+			owner->align_to(*this);
+		return sorted;
+	}
+
+	// Insertion sort of the index range [begin, end), counting the swaps down from swaps_left
+	template <class IndexLess, class OnSwap>
+	bool insertion_sort(unsigned int begin, unsigned int end, IndexLess& indexLess, OnSwap& onSwap, size_t& swaps_left)
+	{
+		for (unsigned int i = begin + 1; i < end; i++)
+			for (unsigned int j = i; j > begin && indexLess(j, j - 1); j--) {
+				if (swaps_left == 0)
+					return false;
+				swaps_left--;
+				swap_at(j, j - 1);
+				onSwap(j, j - 1);
+			}
+		return true;
 	}
 };
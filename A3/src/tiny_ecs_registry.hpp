@@ -3,14 +3,29 @@
 
 #include "tiny_ecs.hpp"
 #include "components.hpp"
+#include "entity_pool.hpp"
+
+// Memory and occupancy of the whole registry, see ECSRegistry::collect_stats
+struct RegistryStats
+{
+	std::vector<ContainerStats> containers; // in registration order
+	ContainerStats total;                   // sums over all containers, the load factor is the largest one
+	size_t entities = 0;                    // entities with at least one component
+	size_t signature_bytes = 0;             // approximate heap memory of the component signatures
+	size_t pending_destroys = 0;
+};
 
 class ECSRegistry
 {
 	// Callbacks to remove a particular or all entities in the system
-	std::vector<ContainerInterface*> registry_list;
+	// Declared first, all the containers below add themselves to it when they are constructed
+	ContainerList registry_list;
+
+	// Entities queued by destroy_deferred, removed at the next apply_deferred
+	std::vector<Entity> pending_destroys;
 
 public:
-	// Manually created list of all components this game has
+	// All components this game has, each one registers itself in registry_list
 	ComponentContainer<DeathTimer> deathTimers;
 	ComponentContainer<Motion> motions;
 	ComponentContainer<Collision> collisions;
@@ -26,28 +41,28 @@ public:
 	ComponentContainer<LightUp> lightUpTimers;
 	ComponentContainer<Physics> physics;
 	ComponentContainer<FeelsGravity> gravity;
+	ComponentContainer<Flocking> flocks;
+	ComponentContainer<Pooled> pooled;
+
+	// The motions and physics of the entities that have both are at the front of the two containers, in the
+	// same order, see OwningGroup. Declared after the containers it owns
+	OwningGroup bodies{ &motions, &physics };
 
-	// constructor that adds all containers for looping over them
-	// IMPORTANT: Don't forget to add any newly added containers!
+	// The containers registered themselves, stop collecting
 	ECSRegistry()
 	{
-		// TODO: A1 add a LightUp component
-		registry_list.push_back(&deathTimers);
-		registry_list.push_back(&motions);
-		registry_list.push_back(&collisions);
-		registry_list.push_back(&players);
-		registry_list.push_back(&meshPtrs);
-		registry_list.push_back(&renderRequests);
-		registry_list.push_back(&screenStates);
-		registry_list.push_back(&softShells);
-		registry_list.push_back(&hardShells);
-		registry_list.push_back(&debugComponents);
-		registry_list.push_back(&colors);
+		registry_list.seal();
 	}
 
+	// The containers by signature bit, e.g. to name the bits of a ComponentSignature
+	size_t container_count() const { return registry_list.size(); }
+	ContainerInterface& container(unsigned int signature_bit) { return *registry_list[signature_bit]; }
+
 	void clear_all_components() {
 		for (ContainerInterface* reg : registry_list)
 			reg->clear();
+		registry_list.signatures.clear();
+		pending_destroys.clear();
 	}
 
 	void list_all_components() {
@@ -59,14 +74,80 @@ public:
 
 	void list_all_components_of(Entity e) {
 		printf("Debug info on components of entity %u:\n", (unsigned int)e);
-		for (ContainerInterface* reg : registry_list)
-			if (reg->has(e))
-				printf("type %s\n", typeid(*reg).name());
+		ComponentSignature signature = registry_list.signatures.get(e);
+		for (unsigned int bit = 0; signature != 0; bit++, signature >>= 1)
+			if (signature & 1)
+				printf("type %s\n", typeid(*registry_list[bit]).name());
+	}
+
+	// Fills stats, re-using its vector so that sampling it regularly doesn't allocate
+	void collect_stats(RegistryStats& stats) {
+		stats.containers.clear();
+		stats.total = ContainerStats();
+		stats.total.type_name = "total";
+		for (ContainerInterface* reg : registry_list) {
+			ContainerStats container = reg->stats();
+			stats.containers.push_back(container);
+			stats.total.count += container.count;
+			stats.total.capacity += container.capacity;
+			stats.total.bucket_count += container.bucket_count;
+			stats.total.load_factor = std::max(stats.total.load_factor, container.load_factor);
+			stats.total.free_nodes += container.free_nodes;
+			stats.total.pending += container.pending;
+			stats.total.bytes += container.bytes;
+		}
+		stats.entities = registry_list.signatures.map_entity_signature.size();
+		stats.signature_bytes = approximate_map_bytes(registry_list.signatures.map_entity_signature, registry_list.signatures.map_free_list.free_blocks);
+		stats.pending_destroys = pending_destroys.size();
+		stats.total.bytes += stats.signature_bytes + pending_destroys.capacity() * sizeof(Entity);
 	}
 
+	void print_stats() {
+		RegistryStats stats;
+		collect_stats(stats);
+		printf("Registry memory: %d entities, %d components, %.1f KB\n", (int)stats.entities, (int)stats.total.count, stats.total.bytes / 1024.f);
+		printf("%8s %8s %8s %6s %8s %10s  %s\n", "count", "capacity", "buckets", "load", "free", "bytes", "type");
+		for (const ContainerStats& c : stats.containers)
+			printf("%8d %8d %8d %6.2f %8d %10d  %s\n", (int)c.count, (int)c.capacity, (int)c.bucket_count, c.load_factor, (int)c.free_nodes, (int)c.bytes, c.type_name);
+	}
+
+	// Only visits the containers in the entity's signature
 	void remove_all_components_of(Entity e) {
+		ComponentSignature signature = registry_list.signatures.get(e);
+		for (unsigned int bit = 0; signature != 0; bit++, signature >>= 1)
+			if (signature & 1)
+				registry_list[bit]->remove(e);
+	}
+
+	// Queue destroying an entity while systems are still iterating, pooled entities go back to their pool
+	void destroy_deferred(Entity e) {
+		pending_destroys.push_back(e);
+	}
+
+	// Whether the entity was already queued for destruction this frame (the queue is short, a scan is fine)
+	bool is_destroy_pending(Entity e) {
+		for (Entity pending : pending_destroys)
+			if ((unsigned int)pending == (unsigned int)e)
+				return true;
+		return false;
+	}
+
+	// Sync point: applies all queued destroys, inserts and removes as one sorted batch,
+	// with a single pass over each container instead of one per entity
+	void apply_deferred() {
+		std::sort(pending_destroys.begin(), pending_destroys.end(), entity_less);
+		pending_destroys.erase(std::unique(pending_destroys.begin(), pending_destroys.end(),
+			[](Entity a, Entity b) { return (unsigned int)a == (unsigned int)b; }), pending_destroys.end());
+		for (Entity e : pending_destroys)
+			if (pooled.has(e))
+				entity_pools[(int)pooled.get(e).prefab].recycle(e);
+		// Containers none of the destroyed entities have only apply their own queued changes
+		ComponentSignature destroyed_signature = 0;
+		for (Entity e : pending_destroys)
+			destroyed_signature |= registry_list.signatures.get(e);
 		for (ContainerInterface* reg : registry_list)
-			reg->remove(e);
+			reg->apply_deferred(pending_destroys, (destroyed_signature >> reg->signature_bit) & 1);
+		pending_destroys.clear();
 	}
 };
 
@@ -1,4 +1,6 @@
 #include "world_init.hpp"
+#include "entity_pool.hpp"
+#include "frame_arena.hpp"
 #include "tiny_ecs_registry.hpp"
 
 Entity createSalmon(RenderSystem* renderer, vec2 pos)
@@ -30,8 +32,8 @@ Entity createSalmon(RenderSystem* renderer, vec2 pos)
 
 Entity createFish(RenderSystem* renderer, vec2 position)
 {
-	// Reserve en entity
-	auto entity = Entity();
+	// Reserve en entity, recycled from the fish that left the screen or got eaten
+	auto entity = entity_pools[(int)PREFAB_ID::FISH].acquire();
 
 	// Store a reference to the potentially re-used mesh object
 	Mesh& mesh = renderer->getMesh(GEOMETRY_BUFFER_ID::SPRITE);
@@ -49,6 +51,8 @@ Entity createFish(RenderSystem* renderer, vec2 position)
 	// Create an (empty) Fish component to be able to refer to all fish
 	auto& softshell = registry.softShells.emplace(entity);
 	softshell.state = SoftShell::NORMAL;
+	// School with the other fish
+	registry.flocks.emplace(entity);
 	registry.renderRequests.insert(
 		entity,
 		{ TEXTURE_ASSET_ID::FISH,
@@ -60,7 +64,7 @@ Entity createFish(RenderSystem* renderer, vec2 position)
 
 Entity createTurtle(RenderSystem* renderer, vec2 position)
 {
-	auto entity = Entity();
+	auto entity = entity_pools[(int)PREFAB_ID::TURTLE].acquire();
 
 	// Store a reference to the potentially re-used mesh object (the value is stored in the resource cache)
 	Mesh& mesh = renderer->getMesh(GEOMETRY_BUFFER_ID::SPRITE);
@@ -71,12 +75,13 @@ Entity createTurtle(RenderSystem* renderer, vec2 position)
 	motion.angle = 0.f;
 	motion.velocity = { -100.f, 0.f };
 	motion.position = position;
-	Physics& physics = registry.physics.emplace(entity);
-
 
 	// Setting initial values, scale is negative to make it face the opposite way
 	motion.scale = vec2({ -TURTLE_BB_WIDTH, TURTLE_BB_HEIGHT });
 
+	// Last, joining registry.bodies moves the motion and invalidates the reference
+	Physics& physics = registry.physics.emplace(entity);
+
 	// Create and (empty) Turtle component to be able to refer to all turtles
 	registry.hardShells.emplace(entity);
 	registry.renderRequests.insert(
@@ -110,9 +115,38 @@ Entity createLine(vec2 position, vec2 scale, float angle)
 	return entity;
 }
 
+// Debug lines of this frame, they live in the frame arena
+struct DebugLine
+{
+	vec2 position;
+	vec2 scale;
+	float angle;
+};
+static FrameVector<DebugLine> debug_lines;
+static unsigned int debug_lines_generation = 0;
+
+void drawDebugLine(vec2 position, vec2 scale, float angle)
+{
+	// The last frame's buffer was released with the arena, start a new one
+	if (debug_lines_generation != frame_arena.generation()) {
+		debug_lines = FrameVector<DebugLine>();
+		debug_lines_generation = frame_arena.generation();
+	}
+	debug_lines.push_back({ position, scale, angle });
+}
+
+void flushDebugLines()
+{
+	if (debug_lines_generation != frame_arena.generation())
+		return;
+	for (const DebugLine& line : debug_lines)
+		createLine(line.position, line.scale, line.angle);
+	debug_lines.clear();
+}
+
 Entity createPebble(vec2 pos, vec2 size)
 {
-	auto entity = Entity();
+	auto entity = entity_pools[(int)PREFAB_ID::PEBBLE].acquire();
 
 	// Setting initial motion values
 	Motion& motion = registry.motions.emplace(entity);
@@ -18,6 +18,10 @@ Entity createFish(RenderSystem* renderer, vec2 position);
 Entity createTurtle(RenderSystem* renderer, vec2 position);
 // a red line for debugging purposes
 Entity createLine(vec2 position, vec2 size, float angle = 0.f);
+// queue a debug line, safe to call while iterating over the registry, the lines are created by flushDebugLines
+void drawDebugLine(vec2 position, vec2 size, float angle = 0.f);
+// create the entities of the queued debug lines, call once per frame before rendering
+void flushDebugLines();
 // a pebble
 Entity createPebble(vec2 pos, vec2 size);
 
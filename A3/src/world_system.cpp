@@ -1,19 +1,16 @@
 // Header
 #include "world_system.hpp"
 #include "world_init.hpp"
+#include "entity_pool.hpp"
+#include "game_config.hpp"
+#include "profiler.hpp"
 
 // stlib
 #include <cassert>
-#include <sstream>
 
 #include "physics_system.hpp"
 
-// Game configuration
-const size_t MAX_TURTLES = 15;
-const size_t MAX_FISH = 5;
-const size_t TURTLE_DELAY_MS = 6000 * 3; //2000->6000
-const size_t FISH_DELAY_MS = 5000 * 3; //5000->9000
-const size_t PEBBLE_DELAY_MS = 1000;
+// Game configuration, the spawn rates and caps are in game_config (see game_config.hpp)
 GLFWwindow* wndptr = nullptr;
 
 // Create the fish world
@@ -101,44 +98,56 @@ GLFWwindow* WorldSystem::create_window(int width, int height) {
 		return nullptr;
 	}
 
-	background_music = Mix_LoadMUS(audio_path("music.wav").c_str());
-	salmon_dead_sound = Mix_LoadWAV(audio_path("salmon_dead.wav").c_str());
-	salmon_eat_sound = Mix_LoadWAV(audio_path("salmon_eat.wav").c_str());
 	Mix_VolumeMusic(25);
 
+	return window;
+}
+
+void WorldSystem::load_audio(JobGraph& loads) {
+	// Reading and decoding the WAV files doesn't need the main thread, the device is open already
+	loads.add([this]() { background_music = Mix_LoadMUS(audio_path("music.wav").c_str()); });
+	loads.add([this]() { salmon_dead_sound = Mix_LoadWAV(audio_path("salmon_dead.wav").c_str()); });
+	loads.add([this]() { salmon_eat_sound = Mix_LoadWAV(audio_path("salmon_eat.wav").c_str()); });
+}
+
+bool WorldSystem::init(RenderSystem* renderer_arg) {
+	this->renderer = renderer_arg;
 	if (background_music == nullptr || salmon_dead_sound == nullptr || salmon_eat_sound == nullptr) {
 		fprintf(stderr, "Failed to load sounds\n %s\n %s\n %s\n make sure the data directory is present",
 			audio_path("music.wav").c_str(),
 			audio_path("salmon_dead.wav").c_str(),
 			audio_path("salmon_eat.wav").c_str());
-		return nullptr;
+		return false;
 	}
-
-	return window;
-}
-
-void WorldSystem::init(RenderSystem* renderer_arg) {
-	this->renderer = renderer_arg;
 	// Playing background music indefinitely
 	Mix_PlayMusic(background_music, -1);
 	fprintf(stderr, "Loaded music\n");
 
 	// Set all states to default
 	restart_game();
+	return true;
 }
 
 // Update our game world
 bool WorldSystem::step(float elapsed_ms_since_last_update) {
+	if (restart_requested)
+		restart_game();
+
 	// Get the screen dimensions
 	int screen_width, screen_height;
 	glfwGetFramebufferSize(window, &screen_width, &screen_height);
 
-	// Updating window title with points
-	std::stringstream title_ss;
-	title_ss << "Points: " << points;
-	glfwSetWindowTitle(window, title_ss.str().c_str());
+	// Updating window title with points, formatted into a fixed buffer so that it doesn't allocate every frame
+	char title[512];
+	int title_length = snprintf(title, sizeof(title), "Points: %d", (int)points);
+	if (profiler.show_overlay) {
+		title_length += snprintf(title + title_length, sizeof(title) - title_length, " | ");
+		profiler.write_overlay(title + title_length, sizeof(title) - title_length);
+	}
+	glfwSetWindowTitle(window, title);
 
-	// Remove debug info from the last step
+	// Remove debug info from the last step right away, queued until the sync point they would go through
+	// the physics and collisions of this step
 	while (registry.debugComponents.entities.size() > 0)
 		registry.remove_all_components_of(registry.debugComponents.entities.back());
 
@@ -146,21 +155,33 @@ bool WorldSystem::step(float elapsed_ms_since_last_update) {
 	auto& motions_registry = registry.motions;
 
 	// Remove entities that leave the screen on the left side
-	// Iterate backwards to be able to remove without unterfering with the next object to visit
-	// (the containers exchange the last element with the current)
 	for (int i = (int)motions_registry.components.size() - 1; i >= 0; --i) {
 		Motion& motion = motions_registry.components[i];
 		if (motion.position.x + abs(motion.scale.x) < 0.f || motion.position.x - abs(motion.scale.x) > screen_width*2 ||
 			motion.position.y + abs(motion.scale.y) < -screen_height || motion.position.y - abs(motion.scale.y) > screen_height) {
-			registry.remove_all_components_of(motions_registry.entities[i]);
+			registry.destroy_deferred(motions_registry.entities[i]);
 		}
 	}
 
+	if (debugging.is_advanced_controls) {
+		double xpos, ypos;
+		glfwGetCursorPos(wndptr, &xpos, &ypos);
+		on_mouse_move({ xpos, ypos });
+	}
+
+	// A stress scenario keeps the population it started with
+	if (scenario != nullptr)
+		return true;
+
 	// Spawning new turtles
+	// The loops below only stop early at the cap. Don't let the time at the cap accumulate, or every later
+	// death would respawn at once.
+	next_turtle_spawn = fmax(next_turtle_spawn, 0.f);
 	next_turtle_spawn -= elapsed_ms_since_last_update * current_speed;
-	if (registry.hardShells.components.size() <= MAX_TURTLES && next_turtle_spawn < 0.f) {
+	// More than one per step when the delay is shorter than a step
+	while (registry.hardShells.components.size() <= game_config.max_turtles && next_turtle_spawn < 0.f) {
 		// Reset timer
-		next_turtle_spawn = (TURTLE_DELAY_MS / 2) + uniform_dist(rng) * (TURTLE_DELAY_MS / 2);
+		next_turtle_spawn += (game_config.turtle_delay_ms / 2) + uniform_dist(rng) * (game_config.turtle_delay_ms / 2);
 		// Create turtle
 		Entity entity = createTurtle(renderer, { 0,0 });
 		// Setting random initial position and constant velocity
@@ -175,11 +196,12 @@ bool WorldSystem::step(float elapsed_ms_since_last_update) {
 	}
 
 	// Spawning new fish
+	next_fish_spawn = fmax(next_fish_spawn, 0.f);
 	next_fish_spawn -= elapsed_ms_since_last_update * current_speed;
-	if (registry.softShells.components.size() <= MAX_FISH && next_fish_spawn < 0.f) {
+	while (registry.softShells.components.size() <= game_config.max_fish && next_fish_spawn < 0.f) {
 		// !!! DONE A1: Create new fish with createFish({0,0}), as for the Turtles above
 		// Reset timer
-		next_fish_spawn = (FISH_DELAY_MS / 2) + uniform_dist(rng) * (FISH_DELAY_MS / 2);
+		next_fish_spawn += (game_config.fish_delay_ms / 2) + uniform_dist(rng) * (game_config.fish_delay_ms / 2);
 		// Create fish
 		Entity entity = createFish(renderer, { 0,0 });
 		// Setting random initial position and constant velocity
@@ -197,7 +219,7 @@ bool WorldSystem::step(float elapsed_ms_since_last_update) {
 	// Spawning new pebble
 	next_pebble_spawn -= elapsed_ms_since_last_update * current_speed;
 	if (next_pebble_spawn < 0.f) {
-		next_pebble_spawn = (PEBBLE_DELAY_MS / 2) + uniform_dist(rng) * (PEBBLE_DELAY_MS / 2);
+		next_pebble_spawn = (game_config.pebble_delay_ms / 2) + uniform_dist(rng) * (game_config.pebble_delay_ms / 2);
 		Motion& player_motion = registry.motions.get(player_salmon);
 		// Setting random initial velocity
 		vec2 pebble_pos = vec2(player_motion.position.x, player_motion.position.y);
@@ -212,14 +234,13 @@ bool WorldSystem::step(float elapsed_ms_since_last_update) {
 		physics.coefficient_of_resititution = 0.3;
 		motion.velocity = pebble_vel;
 	}
+	return true;
+}
+
+void WorldSystem::update_timers(float elapsed_ms_since_last_update) {
 	// Processing the salmon state
 	assert(registry.screenStates.components.size() <= 1);
 	ScreenState& screen = registry.screenStates.components[0];
-	if (debugging.is_advanced_controls) {
-		double xpos, ypos;
-		glfwGetCursorPos(wndptr, &xpos, &ypos);
-		on_mouse_move({ xpos, ypos });
-	}
 
 	float min_counter_ms = 3000.f;
 	for (Entity entity : registry.deathTimers.entities) {
@@ -230,12 +251,12 @@ bool WorldSystem::step(float elapsed_ms_since_last_update) {
 			min_counter_ms = counter.counter_ms;
 		}
 
-		// restart the game once the death timer expired
+		// restart the game once the death timer expired, the restart touches every container so it waits for the next step
 		if (counter.counter_ms < 0) {
-			registry.deathTimers.remove(entity);
+			registry.deathTimers.remove_deferred(entity);
 			screen.darken_screen_factor = 0;
-			restart_game();
-			return true;
+			restart_requested = true;
+			return;
 		}
 	}
 	// reduce window brightness if any of the present salmons is dying
@@ -249,10 +270,9 @@ bool WorldSystem::step(float elapsed_ms_since_last_update) {
 
 		// remove timer once time reaches 0
 		if (counter.counter_ms < 0) {
-			registry.lightUpTimers.remove(entity);
+			registry.lightUpTimers.remove_deferred(entity);
 		}
 	}
-	return true;
 }
 
 // Reset the world state to its initial state
@@ -260,22 +280,34 @@ void WorldSystem::restart_game() {
 	// Debugging for memory/component leaks
 	registry.list_all_components();
 	printf("Restarting\n");
+	profiler.allow_allocations(); // respawning fills the pools and containers again
 
 	// Reset the game speed
 	current_speed = 1.f;
+	restart_requested = false;
+
+	// Apply what was queued so far, so that nothing gets destroyed twice
+	registry.apply_deferred();
 
 	// Remove all entities that we created
 	// All that have a motion, we could also iterate over all fish, turtles, ... but that would be more cumbersome
 	while (registry.motions.entities.size() > 0)
-		registry.remove_all_components_of(registry.motions.entities.back());
+		destroyEntity(registry.motions.entities.back());
 
 	// Debugging for memory/component leaks
-	registry.list_all_components();
+	registry.print_stats();
+	printEntityPoolStats();
 
 	// Create a new salmon
 	player_salmon = createSalmon(renderer, { 100, 200 });
 	registry.colors.insert(player_salmon, { 1, 0.8f, 0.8f });
 
+	if (scenario != nullptr) {
+		int screen_width, screen_height;
+		glfwGetFramebufferSize(window, &screen_width, &screen_height);
+		populateScenario(*scenario, renderer, { (float)screen_width, (float)screen_height });
+	}
+
 	// !! TODO A3: Enable static pebbles on the ground
 	// Create pebbles on the floor for reference
 	/*
@@ -294,6 +326,7 @@ void WorldSystem::restart_game() {
 // Compute collisions between entities
 void WorldSystem::handle_collisions() {
 	// Loop over all collisions detected by the physics system
+	PROFILE_SCOPE("collisions.response");
 	auto& collisionsRegistry = registry.collisions; // TODO: @Tim, is the reference here needed?
 	for (uint i = 0; i < collisionsRegistry.components.size(); i++) {
 		// The entity and its collider
@@ -321,14 +354,16 @@ void WorldSystem::handle_collisions() {
 			}
 			// Checking Player - SoftShell collisions
 			else if (registry.softShells.has(entity_other)) {
-				if (!registry.deathTimers.has(entity)) {
+				// the fish may show up in several collisions before it is removed at the sync point
+				if (!registry.deathTimers.has(entity) && !registry.is_destroy_pending(entity_other)) {
 					// chew, count points, and set the LightUp timer
-					registry.remove_all_components_of(entity_other);
+					registry.destroy_deferred(entity_other);
 					Mix_PlayChannel(-1, salmon_eat_sound, 0);
 					++points;
 
 					// !!! DONE A1: create a new struct called LightUp in components.hpp and add an instance to the salmon entity by modifying the ECS registry
-					registry.lightUpTimers.emplace(entity);
+					// (queued as well, eating again while lit up restarts the timer)
+					registry.lightUpTimers.emplace_deferred(entity);
 				}
 			}
 		}
@@ -445,6 +480,18 @@ void WorldSystem::on_key(int key, int, int action, int mod) {
 		restart_game();
 	}
 
+	// Profiling: P shows the p50/p99 of every system in the title, O saves the recorded timings
+	if (action == GLFW_RELEASE && key == GLFW_KEY_P) {
+		profiler.show_overlay = !profiler.show_overlay;
+	}
+	if (action == GLFW_RELEASE && key == GLFW_KEY_O) {
+		profiler.allow_allocations();
+		if (profiler.write_csv("profile.csv") && profiler.write_chrome_trace("profile_trace.json"))
+			printf("Saved profile.csv and profile_trace.json (%d dropped events)\n", (int)profiler.dropped_events());
+		else
+			fprintf(stderr, "Failed to save the profile\n");
+	}
+
 	// Debugging
 	if (action == GLFW_PRESS && key == GLFW_KEY_D) {
 		debugging.in_debug_mode = !debugging.in_debug_mode;
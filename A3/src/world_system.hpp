@@ -12,6 +12,8 @@
 #include <SDL_mixer.h>
 
 #include "render_system.hpp"
+#include "scenario.hpp"
+#include "thread_pool.hpp"
 
 // Container for all our entities and game logic. Individual rendering / update is
 // deferred to the relative update() methods
@@ -23,8 +25,14 @@ public:
 	// Creates a window
 	GLFWwindow* create_window(int width, int height);
 
-	// starts the game
-	void init(RenderSystem* renderer);
+	// Queues decoding the music and sounds, call after create_window
+	void load_audio(JobGraph& loads);
+
+	// Starts every game with the scenario's population instead of spawning over time, call before init
+	void set_scenario(const Scenario* scenario_arg) { scenario = scenario_arg; }
+
+	// starts the game once the loads ran, false if the audio is missing
+	bool init(RenderSystem* renderer);
 
 	// Releases all associated resources
 	~WorldSystem();
@@ -32,6 +40,9 @@ public:
 	// Steps the game ahead by ms milliseconds
 	bool step(float elapsed_ms);
 
+	// Counts down the death and LightUp timers, separate from step so it can run alongside the AI
+	void update_timers(float elapsed_ms);
+
 	// Check for collisions
 	void handle_collisions();
 
@@ -58,11 +69,13 @@ private:
 	float next_fish_spawn;
 	float next_pebble_spawn;
 	Entity player_salmon;
+	bool restart_requested = false; // the death timer expired, restart at the start of the next step
+	const Scenario* scenario = nullptr;
 
 	// music references
-	Mix_Music* background_music;
-	Mix_Chunk* salmon_dead_sound;
-	Mix_Chunk* salmon_eat_sound;
+	Mix_Music* background_music = nullptr;
+	Mix_Chunk* salmon_dead_sound = nullptr;
+	Mix_Chunk* salmon_eat_sound = nullptr;
 
 	// C++ random number generator
 	std::default_random_engine rng;
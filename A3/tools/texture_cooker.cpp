@@ -0,0 +1,252 @@
+// Cooks PNG textures for RenderSystem: decodes them once, builds the mip chain and writes it next to the PNG
+// (fish.png -> fish.png.tex, see src/cooked_texture.hpp), as RGBA8 or, with --bc3, block compressed.
+// usage: texture_cooker [--bc3] file.png...
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "../ext/stb_image/stb_image.h"
+
+// stlib
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <vector>
+
+// internal
+#include "cooked_texture.hpp"
+
+struct Image
+{
+	int width;
+	int height;
+	std::vector<uint8_t> rgba;
+};
+
+// Halves the image with a 2x2 box filter. The colors are weighted by their alpha, so that the invisible
+// color of transparent pixels doesn't bleed into the edges of a sprite
+static Image downsample(const Image& source)
+{
+	Image result;
+	result.width = std::max(1, source.width / 2);
+	result.height = std::max(1, source.height / 2);
+	result.rgba.resize((size_t)result.width * result.height * 4);
+	for (int y = 0; y < result.height; y++)
+		for (int x = 0; x < result.width; x++) {
+			float color[3] = { 0.f, 0.f, 0.f };
+			float unweighted[3] = { 0.f, 0.f, 0.f };
+			float alpha = 0.f;
+			for (int dy = 0; dy < 2; dy++)
+				for (int dx = 0; dx < 2; dx++) {
+					int sx = std::min(x * 2 + dx, source.width - 1);
+					int sy = std::min(y * 2 + dy, source.height - 1);
+					const uint8_t* pixel = &source.rgba[((size_t)sy * source.width + sx) * 4];
+					for (int c = 0; c < 3; c++) {
+						color[c] += pixel[c] * (float)pixel[3];
+						unweighted[c] += pixel[c];
+					}
+					alpha += pixel[3];
+				}
+			uint8_t* pixel = &result.rgba[((size_t)y * result.width + x) * 4];
+			for (int c = 0; c < 3; c++)
+				pixel[c] = (uint8_t)(alpha > 0.f ? color[c] / alpha + 0.5f : unweighted[c] / 4.f + 0.5f);
+			pixel[3] = (uint8_t)(alpha / 4.f + 0.5f);
+		}
+	return result;
+}
+
+static uint16_t to_565(const float color[3])
+{
+	int r = (int)(color[0] * 31.f / 255.f + 0.5f);
+	int g = (int)(color[1] * 63.f / 255.f + 0.5f);
+	int b = (int)(color[2] * 31.f / 255.f + 0.5f);
+	return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+static void from_565(uint16_t packed, float color[3])
+{
+	color[0] = ((packed >> 11) & 31) * 255.f / 31.f;
+	color[1] = ((packed >> 5) & 63) * 255.f / 63.f;
+	color[2] = (packed & 31) * 255.f / 31.f;
+}
+
+// One 4x4 block of BC3: 8 bytes of interpolated alpha, then 8 bytes of color like BC1. The endpoints are
+// the (slightly inset) bounding box of the block, each pixel takes the nearest palette entry
+static void encode_bc3_block(const uint8_t pixels[16][4], uint8_t out[16])
+{
+	memset(out, 0, 16);
+
+	uint8_t alpha_max = 0, alpha_min = 255;
+	for (int i = 0; i < 16; i++) {
+		alpha_max = std::max(alpha_max, pixels[i][3]);
+		alpha_min = std::min(alpha_min, pixels[i][3]);
+	}
+	out[0] = alpha_max;
+	out[1] = alpha_min;
+	if (alpha_max != alpha_min) {
+		// alpha_0 > alpha_1 selects 6 interpolated values between them, index 0 and 1 are the endpoints
+		float palette[8];
+		palette[0] = alpha_max;
+		palette[1] = alpha_min;
+		for (int i = 1; i < 7; i++)
+			palette[i + 1] = ((7 - i) * alpha_max + i * alpha_min) / 7.f;
+		uint64_t bits = 0;
+		for (int i = 0; i < 16; i++) {
+			int best = 0;
+			for (int p = 1; p < 8; p++)
+				if (std::abs(palette[p] - pixels[i][3]) < std::abs(palette[best] - pixels[i][3]))
+					best = p;
+			bits |= (uint64_t)best << (3 * i);
+		}
+		for (int i = 0; i < 6; i++)
+			out[2 + i] = (uint8_t)(bits >> (8 * i));
+	}
+
+	// Invisible pixels don't get a say in the colors, unless the whole block is invisible
+	float low[3] = { 255.f, 255.f, 255.f }, high[3] = { 0.f, 0.f, 0.f };
+	bool any_visible = alpha_max > 0;
+	for (int i = 0; i < 16; i++) {
+		if (any_visible && pixels[i][3] == 0)
+			continue;
+		for (int c = 0; c < 3; c++) {
+			low[c] = std::min(low[c], (float)pixels[i][c]);
+			high[c] = std::max(high[c], (float)pixels[i][c]);
+		}
+	}
+	for (int c = 0; c < 3; c++) {
+		float inset = (high[c] - low[c]) / 16.f;
+		low[c] += inset;
+		high[c] -= inset;
+	}
+	uint16_t color0 = to_565(high), color1 = to_565(low);
+	out[8] = (uint8_t)color0;
+	out[9] = (uint8_t)(color0 >> 8);
+	out[10] = (uint8_t)color1;
+	out[11] = (uint8_t)(color1 >> 8);
+	// BC3 always uses the 4 color palette: the endpoints, 2/3 of one and 1/3 of the other
+	float palette[4][3];
+	from_565(color0, palette[0]);
+	from_565(color1, palette[1]);
+	for (int c = 0; c < 3; c++) {
+		palette[2][c] = (2.f * palette[0][c] + palette[1][c]) / 3.f;
+		palette[3][c] = (palette[0][c] + 2.f * palette[1][c]) / 3.f;
+	}
+	uint32_t bits = 0;
+	for (int i = 0; i < 16; i++) {
+		int best = 0;
+		float best_distance = 1e30f;
+		for (int p = 0; p < 4; p++) {
+			float distance = 0.f;
+			for (int c = 0; c < 3; c++)
+				distance += (palette[p][c] - pixels[i][c]) * (palette[p][c] - pixels[i][c]);
+			if (distance < best_distance) {
+				best_distance = distance;
+				best = p;
+			}
+		}
+		bits |= (uint32_t)best << (2 * i);
+	}
+	for (int i = 0; i < 4; i++)
+		out[12 + i] = (uint8_t)(bits >> (8 * i));
+}
+
+// Blocks at the right and bottom edge repeat the last column and row
+static std::vector<uint8_t> encode_bc3(const Image& image)
+{
+	int blocks_x = (image.width + 3) / 4, blocks_y = (image.height + 3) / 4;
+	std::vector<uint8_t> result((size_t)blocks_x * blocks_y * 16);
+	for (int by = 0; by < blocks_y; by++)
+		for (int bx = 0; bx < blocks_x; bx++) {
+			uint8_t pixels[16][4];
+			for (int i = 0; i < 16; i++) {
+				int x = std::min(bx * 4 + i % 4, image.width - 1);
+				int y = std::min(by * 4 + i / 4, image.height - 1);
+				memcpy(pixels[i], &image.rgba[((size_t)y * image.width + x) * 4], 4);
+			}
+			encode_bc3_block(pixels, &result[((size_t)by * blocks_x + bx) * 16]);
+		}
+	return result;
+}
+
+static bool cook(const std::string& png_path, CookedTextureFormat format)
+{
+	struct stat source;
+	Image image;
+	stbi_uc* pixels = stbi_load(png_path.c_str(), &image.width, &image.height, NULL, 4);
+	if (pixels == NULL || stat(png_path.c_str(), &source) != 0) {
+		fprintf(stderr, "Could not load the file %s\n", png_path.c_str());
+		stbi_image_free(pixels);
+		return false;
+	}
+	image.rgba.assign(pixels, pixels + (size_t)image.width * image.height * 4);
+	stbi_image_free(pixels);
+
+	// Down to 1x1
+	std::vector<std::vector<uint8_t>> payloads;
+	std::vector<CookedTextureLevel> levels;
+	while (true) {
+		CookedTextureLevel level = { (uint32_t)image.width, (uint32_t)image.height, 0, 0 };
+		payloads.push_back(format == CookedTextureFormat::BC3 ? encode_bc3(image) : image.rgba);
+		level.size = payloads.back().size();
+		levels.push_back(level);
+		if (image.width == 1 && image.height == 1)
+			break;
+		image = downsample(image);
+	}
+
+	CookedTextureHeader header;
+	memcpy(header.magic, "CTEX", 4);
+	header.version = COOKED_TEXTURE_VERSION;
+	header.format = format;
+	header.width = levels[0].width;
+	header.height = levels[0].height;
+	header.mip_count = (uint32_t)levels.size();
+	header.source_mtime = (int64_t)source.st_mtime;
+	header.source_size = (uint64_t)source.st_size;
+	uint64_t offset = sizeof(CookedTextureHeader) + levels.size() * sizeof(CookedTextureLevel);
+	for (CookedTextureLevel& level : levels) {
+		level.offset = offset;
+		offset += level.size; // RGBA8 rows and BC3 blocks keep the offsets 4 byte aligned
+	}
+
+	std::string cooked_path = cookedTexturePath(png_path);
+	FILE* file = fopen(cooked_path.c_str(), "wb");
+	if (file == NULL) {
+		fprintf(stderr, "Could not write %s\n", cooked_path.c_str());
+		return false;
+	}
+	bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+		fwrite(levels.data(), sizeof(CookedTextureLevel), levels.size(), file) == levels.size();
+	for (const std::vector<uint8_t>& payload : payloads)
+		written = written && fwrite(payload.data(), 1, payload.size(), file) == payload.size();
+	written = fclose(file) == 0 && written;
+	if (!written) {
+		fprintf(stderr, "Could not write %s\n", cooked_path.c_str());
+		remove(cooked_path.c_str());
+		return false;
+	}
+	printf("%s: %ux%u, %zu levels, %s, %.1f KB on the GPU (%.1f KB as RGBA8 without mips)\n", cooked_path.c_str(), header.width, header.height,
+		levels.size(), format == CookedTextureFormat::BC3 ? "BC3" : "RGBA8", (offset - levels[0].offset) / 1024.0, header.width * header.height * 4 / 1024.0);
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	CookedTextureFormat format = CookedTextureFormat::RGBA8;
+	int cooked = 0, failed = 0;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--bc3") == 0)
+			format = CookedTextureFormat::BC3;
+		else if (cook(argv[i], format))
+			cooked++;
+		else
+			failed++;
+	}
+	if (cooked + failed == 0) {
+		fprintf(stderr, "usage: texture_cooker [--bc3] file.png...\n");
+		return 1;
+	}
+	return failed == 0 ? 0 : 1;
+}